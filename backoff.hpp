@@ -0,0 +1,122 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_BACKOFF_HPP
+#define CONCURRENT_BACKOFF_HPP
+
+#include <cstdint>
+
+#include <functional>
+#include <thread>
+
+namespace concurrent
+{
+//	Hint to cpu that calling thread is spinning, lets sibling hyper-thread
+//	run and lowers power use of spin loops.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+//	Spins doubling number of cpu_relax() calls on every pause(), after
+//	MAX_SPINS yields to scheduler, so waiting on preempted thread does not
+//	burn whole time slice.
+class exponential_backoff
+{
+public:
+	static constexpr uint32_t MAX_SPINS = 1024;
+
+	inline void pause() {
+		if (spins <= MAX_SPINS) {
+			for (uint32_t i = 0; i < spins; ++i) {
+				cpu_relax();
+			}
+			spins *= 2;
+		} else {
+			std::this_thread::yield();
+		}
+	}
+
+	inline void reset() {
+		spins = 1;
+	}
+
+private:
+	uint32_t spins = 1;
+};
+
+//	Backoff policies for lock-free retry loops, Backoff parameter of
+//	mpsc::stack and mpmc_stack. Fresh object is used for every operation and
+//	pause() is called after each failed CAS, so uncontended operations never
+//	touch it. exponential_backoff above is the default.
+
+//	Retries immediately.
+class no_backoff
+{
+public:
+	inline void pause() {}
+	inline void reset() {}
+};
+
+//	Spins SPIN_TRIES times, then yields on every pause(). For waiting until
+//	other thread makes whole batch of progress, which exponential spinning
+//	would only delay on oversubscribed cores.
+class spin_then_yield_backoff
+{
+public:
+	static constexpr uint32_t SPIN_TRIES = 100;
+
+	inline void pause() {
+		if (spins < SPIN_TRIES) {
+			++spins;
+			cpu_relax();
+		} else {
+			std::this_thread::yield();
+		}
+	}
+
+	inline void reset() {
+		spins = 0;
+	}
+
+private:
+	uint32_t spins = 0;
+};
+
+//	Spins random number of cpu_relax() calls below window, which doubles on
+//	every pause() up to MAX_SPINS. Randomization keeps threads that failed
+//	together from retrying in lockstep.
+class randomized_backoff
+{
+public:
+	static constexpr uint32_t MAX_SPINS = 1024;
+
+	inline void pause() {
+		thread_local uint32_t seed =
+			(uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		for (uint32_t i = seed & (window - 1); i > 0; --i) {
+			cpu_relax();
+		}
+		if (window < MAX_SPINS) {
+			window *= 2;
+		}
+	}
+
+	inline void reset() {
+		window = 2;
+	}
+
+private:
+	uint32_t window = 2;
+};
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_BENCH_BENCH_HPP
+#define CONCURRENT_BENCH_BENCH_HPP
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "../time.hpp"
+
+namespace bench
+{
+// Runs iterations of measured operation and returns number of performed
+// operations.
+using function = std::function<uint64_t(uint64_t iterations)>;
+
+struct entry {
+	std::string name;
+	function func;
+	uint64_t iterations;
+};
+
+std::vector<entry> &registry();
+
+struct registrar {
+	registrar(const std::string &name, uint64_t iterations, function func)
+	{
+		registry().push_back({name, func, iterations});
+	}
+};
+
+// Thread counts 1, 2, 4, ... up to std::thread::hardware_concurrency().
+std::vector<size_t> thread_counts();
+
+// Prints p50/p99/p999/max of samples (nanoseconds), sorts samples. Values
+// are also attached to result of currently running benchmark for --json.
+void print_percentiles(const char *name, std::vector<int64_t> &samples);
+
+// Whether --pin was given on command line.
+bool pinning_enabled();
+
+// With --pin binds calling thread to cpu (index modulo available cpus),
+// otherwise does nothing. Benchmarks call it with index of their thread.
+void pin_thread(size_t index);
+
+// Payload sizes in bytes used by size parametrised benchmarks.
+inline constexpr size_t payload_sizes[] = {8, 64, 256};
+
+// Trivially copyable payload of BYTES bytes, first word carries value.
+template <size_t BYTES> struct payload {
+	uint64_t value = 0;
+	uint8_t pad[BYTES > sizeof(uint64_t) ? BYTES - sizeof(uint64_t) : 1];
+};
+
+// Prevents compiler from optimising away computation of value.
+template <typename T> inline void do_not_optimize(T &value)
+{
+	asm volatile("" : "+m"(value) : : "memory");
+}
+} // namespace bench
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK(NAME, ITERATIONS, ...)                                       \
+	static bench::registrar BENCH_CONCAT(_bench_registrar_, __LINE__)(         \
+		NAME, ITERATIONS, __VA_ARGS__)
+
+#endif
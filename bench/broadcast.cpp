@@ -0,0 +1,129 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../broadcast_ring.hpp"
+#include "../spsc_ringbuffer.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+constexpr size_t RING_SIZE = 1024;
+constexpr size_t BATCH = 16;
+constexpr size_t consumer_counts[] = {1, 2, 6};
+
+using event = bench::payload<64>;
+
+// Single producer publishes every event once, all consumers read it in
+// place. Producer claims BATCH slots at once.
+template <typename Wait> uint64_t ring(uint64_t n, size_t consumers)
+{
+	using ring_t = concurrent::broadcast::ring<event, RING_SIZE,
+											   concurrent::broadcast::single_producer,
+											   Wait>;
+	std::unique_ptr<ring_t> r = std::make_unique<ring_t>();
+	std::vector<concurrent::broadcast::sequence> seqs(consumers);
+	typename ring_t::barrier barrier = r->new_barrier();
+	for (concurrent::broadcast::sequence &s : seqs) {
+		r->add_gating_sequence(s);
+	}
+	n -= n % BATCH;
+	std::vector<std::thread> threads;
+	for (size_t c = 0; c < consumers; ++c) {
+		threads.emplace_back([&, c]() {
+			bench::pin_thread(c);
+			uint64_t sum = 0;
+			for (uint64_t i = 0; i < n;) {
+				i += barrier.process(seqs[c], [&](event &e, int64_t, bool) {
+					sum += e.value;
+				});
+			}
+			bench::do_not_optimize(sum);
+		});
+	}
+	bench::pin_thread(consumers);
+	for (uint64_t i = 0; i < n; i += BATCH) {
+		const int64_t first = r->claim(BATCH);
+		for (size_t k = 0; k < BATCH; ++k) {
+			(*r)[first + k].value = i + k;
+		}
+		r->publish(first, BATCH);
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	return n;
+}
+
+// Baseline, producer copies every event into own spsc::ringbuffer of each
+// consumer.
+uint64_t spsc_fanout(uint64_t n, size_t consumers)
+{
+	using ring_t = concurrent::spsc::ringbuffer<event, RING_SIZE>;
+	std::vector<std::unique_ptr<ring_t>> rings;
+	for (size_t c = 0; c < consumers; ++c) {
+		rings.push_back(std::make_unique<ring_t>());
+	}
+	std::vector<std::thread> threads;
+	for (size_t c = 0; c < consumers; ++c) {
+		threads.emplace_back([&, c]() {
+			bench::pin_thread(c);
+			uint64_t sum = 0;
+			event e;
+			for (uint64_t i = 0; i < n;) {
+				if (rings[c]->pop(e)) {
+					sum += e.value;
+					++i;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+			bench::do_not_optimize(sum);
+		});
+	}
+	bench::pin_thread(consumers);
+	event e;
+	for (uint64_t i = 0; i < n; ++i) {
+		e.value = i;
+		for (std::unique_ptr<ring_t> &r : rings) {
+			while (r->push(e) == false) {
+				std::this_thread::yield();
+			}
+		}
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	return n;
+}
+
+struct registrations {
+	registrations()
+	{
+		for (size_t consumers : consumer_counts) {
+			const std::string suffix = "/" + std::to_string(consumers);
+			bench::registrar("broadcast/ring/yielding" + suffix, 2'000'000,
+							 [consumers](uint64_t n) {
+								 return ring<concurrent::broadcast::yielding_wait>(
+									 n, consumers);
+							 });
+			bench::registrar("broadcast/ring/blocking" + suffix, 2'000'000,
+							 [consumers](uint64_t n) {
+								 return ring<concurrent::broadcast::blocking_wait>(
+									 n, consumers);
+							 });
+			bench::registrar("broadcast/baseline/spsc_fanout" + suffix,
+							 2'000'000, [consumers](uint64_t n) {
+								 return spsc_fanout(n, consumers);
+							 });
+		}
+	}
+} registrations;
+} // namespace
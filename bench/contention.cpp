@@ -0,0 +1,178 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mpsc_stack.hpp"
+#include "../mpmc_stack.hpp"
+#include "../object_pool.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+struct item : concurrent::node<item> {
+	uint64_t value = 0;
+};
+
+void print_contention(const std::string &name,
+					  const concurrent::contention_snapshot &s)
+{
+	if (concurrent::contention_counters::enabled == false) {
+		return;
+	}
+	printf("  %-38s cas_failures %llu locks %llu contended %llu wait %lld ns "
+		   "hold %lld ns\n",
+		   name.c_str(), (unsigned long long)s.cas_failures,
+		   (unsigned long long)s.lock_acquisitions,
+		   (unsigned long long)s.lock_contended, (long long)s.lock_wait.ns,
+		   (long long)s.lock_hold.ns);
+}
+
+// Producers pushing while single consumer keeps taking everything with
+// pop_all().
+template <typename Backoff>
+uint64_t mpsc_stack(uint64_t n, size_t threads, const std::string &name)
+{
+	concurrent::mpsc::stack<item, Backoff> stack;
+	const uint64_t per_thread = n / threads;
+	std::vector<item> items(per_thread * threads);
+	std::atomic<size_t> done = 0;
+	std::vector<std::thread> producers;
+	for (size_t t = 0; t < threads; ++t) {
+		producers.emplace_back([&, t]() {
+			bench::pin_thread(t);
+			for (uint64_t i = 0; i < per_thread; ++i) {
+				stack.push(&items[t * per_thread + i]);
+			}
+			done.fetch_add(1);
+		});
+	}
+	uint64_t taken = 0;
+	while (done.load() < threads || stack.empty() == false) {
+		for (item *it = stack.pop_all(); it != NULL;
+			 it = it->__m_next.load(std::memory_order_relaxed)) {
+			++taken;
+		}
+	}
+	for (std::thread &t : producers) {
+		t.join();
+	}
+	print_contention(name, stack.get_contention_stats());
+	return taken;
+}
+
+// Free-list pattern, every thread pops node and pushes it back, so pushes
+// and pops race on head, or meet in elimination array when SLOTS > 0.
+template <typename Backoff, size_t SLOTS = 0>
+uint64_t mpmc_stack(uint64_t n, size_t threads, const std::string &name)
+{
+	concurrent::mpmc::mpmc_stack<item, std::mutex, Backoff, SLOTS> stack;
+	std::vector<item> items(threads * 64);
+	for (item &it : items) {
+		stack.push(&it);
+	}
+	const uint64_t per_thread = n / threads;
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			bench::pin_thread(t);
+			for (uint64_t i = 0; i < per_thread; ++i) {
+				if (item *it = stack.pop()) {
+					stack.push(it);
+				}
+			}
+		});
+	}
+	for (std::thread &t : workers) {
+		t.join();
+	}
+	print_contention(name, stack.get_stack_contention_stats());
+	// Stack deletes nodes left in it on destruction.
+	stack.pop_all();
+	return per_thread * threads * 2;
+}
+
+struct backoff_entry {
+	std::string name;
+	uint64_t (*mpsc)(uint64_t, size_t, const std::string &);
+	uint64_t (*mpmc)(uint64_t, size_t, const std::string &);
+};
+
+const backoff_entry backoffs[] = {
+	{"no_backoff", mpsc_stack<concurrent::no_backoff>,
+	 mpmc_stack<concurrent::no_backoff>},
+	{"exponential_backoff", mpsc_stack<concurrent::exponential_backoff>,
+	 mpmc_stack<concurrent::exponential_backoff>},
+	{"randomized_backoff", mpsc_stack<concurrent::randomized_backoff>,
+	 mpmc_stack<concurrent::randomized_backoff>},
+};
+
+struct registrations {
+	registrations()
+	{
+		for (size_t threads : bench::thread_counts()) {
+			for (const backoff_entry &b : backoffs) {
+				const std::string suffix =
+					b.name + "/" + std::to_string(threads);
+				std::string name = "contention/mpsc_stack/" + suffix;
+				bench::registrar(name, 4'000'000,
+								 [threads, name, f = b.mpsc](uint64_t n) {
+									 return f(n, threads, name);
+								 });
+				name = "contention/mpmc_stack/" + suffix;
+				bench::registrar(name, 4'000'000,
+								 [threads, name, f = b.mpmc](uint64_t n) {
+									 return f(n, threads, name);
+								 });
+			}
+			const std::string elimination =
+				"contention/mpmc_stack_elimination/" + std::to_string(threads);
+			bench::registrar(
+				elimination, 4'000'000, [threads, elimination](uint64_t n) {
+					return mpmc_stack<concurrent::exponential_backoff, 4>(
+						n, threads, elimination);
+				});
+
+			// Threads hammering thread_local_pool with small buckets, so
+			// refills and flushes go through global pool mutex often.
+			const std::string name =
+				"contention/buckets_pool/" + std::to_string(threads);
+			bench::registrar(name, 4'000'000, [threads, name](uint64_t n) {
+				using pool = concurrent::object_pool<item, 16>;
+				const uint64_t per_thread = n / threads;
+				std::vector<std::thread> workers;
+				concurrent::contention_snapshot before =
+					pool::global().get_contention_stats();
+				for (size_t t = 0; t < threads; ++t) {
+					workers.emplace_back([&]() {
+						item *batch[64];
+						for (uint64_t i = 0; i < per_thread; i += 64) {
+							pool::acquire_n(batch, 64);
+							pool::release_n(batch, 64);
+						}
+					});
+				}
+				for (std::thread &t : workers) {
+					t.join();
+				}
+				concurrent::contention_snapshot after =
+					pool::global().get_contention_stats();
+				after.lock_acquisitions -= before.lock_acquisitions;
+				after.lock_contended -= before.lock_contended;
+				after.lock_wait -= before.lock_wait;
+				after.lock_hold -= before.lock_hold;
+				print_contention(name, after);
+				return per_thread * threads;
+			});
+		}
+	}
+} registrations;
+} // namespace
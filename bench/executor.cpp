@@ -0,0 +1,99 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../executor.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+// Tiny task body, well below 1us.
+inline void spin_work(std::atomic<uint64_t> &counter)
+{
+	uint64_t x = 0;
+	for (int i = 0; i < 16; ++i) {
+		bench::do_not_optimize(x);
+		++x;
+	}
+	counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+void fork_tree(concurrent::executor &ex, std::atomic<uint64_t> &counter,
+			   int depth)
+{
+	if (depth == 0) {
+		spin_work(counter);
+		return;
+	}
+	ex.execute([&ex, &counter, depth]() { fork_tree(ex, counter, depth - 1); });
+	ex.execute([&ex, &counter, depth]() { fork_tree(ex, counter, depth - 1); });
+}
+
+void wait_for_count(std::atomic<uint64_t> &counter, uint64_t n)
+{
+	while (counter.load(std::memory_order_acquire) < n) {
+		std::this_thread::yield();
+	}
+}
+
+struct registrations {
+	registrations()
+	{
+		for (size_t threads : bench::thread_counts()) {
+			std::string suffix = "/" + std::to_string(threads);
+
+			// Tasks submitted from outside thread through injection queue.
+			bench::registrar(
+				"executor/external_submit" + suffix, 1'000'000,
+				[threads](uint64_t n) {
+					concurrent::executor ex(threads);
+					std::atomic<uint64_t> counter = 0;
+					for (uint64_t i = 0; i < n; ++i) {
+						ex.execute([&counter]() { spin_work(counter); });
+					}
+					wait_for_count(counter, n);
+					return n;
+				});
+
+			// Tasks spawned by tasks, spread by work stealing.
+			bench::registrar(
+				"executor/fork_tree" + suffix, 1 << 20, [threads](uint64_t n) {
+					concurrent::executor ex(threads);
+					std::atomic<uint64_t> counter = 0;
+					int depth = 0;
+					while ((1ull << depth) < n) {
+						++depth;
+					}
+					ex.execute([&]() { fork_tree(ex, counter, depth); });
+					wait_for_count(counter, 1ull << depth);
+					return 1ull << depth;
+				});
+
+			// Time from submit until task starts, one task in flight.
+			bench::registrar(
+				"executor/submit_latency" + suffix, 20'000,
+				[threads](uint64_t n) {
+					concurrent::executor ex(threads);
+					std::vector<int64_t> samples;
+					samples.reserve(n);
+					for (uint64_t i = 0; i < n; ++i) {
+						concurrent::time::point begin = concurrent::time::now();
+						concurrent::future<int64_t> f = ex.submit([begin]() {
+							return (concurrent::time::now() - begin).ns;
+						});
+						samples.push_back(f.get());
+					}
+					bench::print_percentiles("submit -> start", samples);
+					return n;
+				});
+		}
+	}
+} registrations_instance;
+} // namespace
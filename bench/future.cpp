@@ -0,0 +1,88 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "../future.hpp"
+
+#include "bench.hpp"
+
+BENCHMARK("future/round_trip", 10'000'000, [](uint64_t n) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		p.set_value(i);
+		sum += f.get();
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+BENCHMARK("future/round_trip_copied", 10'000'000, [](uint64_t n) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		concurrent::future<uint64_t> f2 = f;
+		p.set_value(i);
+		sum += f2.get();
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+BENCHMARK("future/std_round_trip", 10'000'000, [](uint64_t n) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		std::promise<uint64_t> p;
+		std::future<uint64_t> f = p.get_future();
+		p.set_value(i);
+		sum += f.get();
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+// Two threads passing token back and forth through futures, each wait
+// sleeps in kernel until the other side sets the value.
+BENCHMARK("future/ping_pong", 20'000, [](uint64_t n) {
+	std::vector<concurrent::promise<uint64_t>> ping(n), pong(n);
+	std::vector<concurrent::future<uint64_t>> ping_f, pong_f;
+	for (uint64_t i = 0; i < n; ++i) {
+		ping_f.push_back(ping[i].get_future());
+		pong_f.push_back(pong[i].get_future());
+	}
+	std::thread other([&]() {
+		for (uint64_t i = 0; i < n; ++i) {
+			ping_f[i].wait_for_seconds(10.0);
+			pong[i].set_value(ping_f[i].get() + 1);
+		}
+	});
+	uint64_t v = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		ping[i].set_value(v);
+		pong_f[i].wait_for_seconds(10.0);
+		v = pong_f[i].get();
+	}
+	other.join();
+	bench::do_not_optimize(v);
+	return n;
+});
+
+BENCHMARK("future/then", 5'000'000, [](uint64_t n) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future().then(
+			[](concurrent::future<uint64_t> &f) { return f.get() + 1; });
+		p.set_value(i);
+		sum += f.get();
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
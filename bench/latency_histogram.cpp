@@ -0,0 +1,90 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../latency_histogram.hpp"
+#include "../future.hpp"
+
+#include "bench.hpp"
+
+BENCHMARK("latency_histogram/record", 50'000'000, [](uint64_t n) {
+	concurrent::latency_histogram hist;
+	for (uint64_t i = 0; i < n; ++i) {
+		hist.record({(int64_t)(i & 0xFFFF)});
+	}
+	concurrent::latency_histogram::snapshot s = hist.read();
+	bench::do_not_optimize(s.total);
+	return n;
+});
+
+BENCHMARK("latency_histogram/record_since", 20'000'000, [](uint64_t n) {
+	concurrent::latency_histogram hist;
+	for (uint64_t i = 0; i < n; ++i) {
+		hist.record_since(concurrent::time::now_fast());
+	}
+	return n;
+});
+
+// Futures completed by other thread with hook enabled, prints distribution
+// of time spent sleeping in future::wait().
+BENCHMARK("latency_histogram/future_wait_hook", 20'000, [](uint64_t n) {
+	concurrent::latency_histogram hist;
+	concurrent::latency_hooks::future_wait.store(&hist);
+	std::vector<concurrent::promise<uint64_t>> promises(n);
+	std::vector<concurrent::future<uint64_t>> futures;
+	for (uint64_t i = 0; i < n; ++i) {
+		futures.push_back(promises[i].get_future());
+	}
+	std::thread producer([&]() {
+		for (uint64_t i = 0; i < n; ++i) {
+			concurrent::time::sleep_for(concurrent::time::microseconds(5));
+			promises[i].set_value(i);
+		}
+	});
+	for (uint64_t i = 0; i < n; ++i) {
+		futures[i].wait();
+	}
+	producer.join();
+	concurrent::latency_hooks::future_wait.store(NULL);
+	concurrent::latency_histogram::snapshot s = hist.read();
+	printf("%-40s %8llu waits p50 %lld p99 %lld p999 %lld max %lld ns\n",
+		   "latency_histogram/future_wait_hook", (unsigned long long)s.count(),
+		   (long long)s.p50().ns, (long long)s.p99().ns,
+		   (long long)s.p999().ns, (long long)s.max().ns);
+	return n;
+});
+
+namespace
+{
+struct registrations {
+	registrations()
+	{
+		for (size_t threads : bench::thread_counts()) {
+			bench::registrar(
+				"latency_histogram/record_mt/" + std::to_string(threads),
+				20'000'000, [threads](uint64_t n) {
+					concurrent::latency_histogram hist;
+					std::vector<std::thread> workers;
+					const uint64_t per_thread = n / threads;
+					for (size_t t = 0; t < threads; ++t) {
+						workers.emplace_back([&]() {
+							for (uint64_t i = 0; i < per_thread; ++i) {
+								hist.record({(int64_t)(i & 0xFFFF)});
+							}
+						});
+					}
+					for (std::thread &t : workers) {
+						t.join();
+					}
+					return per_thread * threads;
+				});
+		}
+	}
+} registrations;
+} // namespace
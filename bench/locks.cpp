@@ -0,0 +1,134 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../locks.hpp"
+#include "../mpmc_stack.hpp"
+#include "../object_pool.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+// Every LATENCY_SAMPLE_MASK+1-th acquisition is timed.
+constexpr uint64_t LATENCY_SAMPLE_MASK = 63;
+
+struct item : concurrent::node<item> {
+	uint64_t value = 0;
+};
+
+void print_contention(const concurrent::contention_snapshot &s)
+{
+	if (concurrent::contention_counters::enabled == false ||
+		s.lock_acquisitions == 0) {
+		return;
+	}
+	printf("  %-38s contended %llu/%llu avg wait %lld ns avg hold %lld ns\n",
+		   "lock", (unsigned long long)s.lock_contended,
+		   (unsigned long long)s.lock_acquisitions,
+		   (long long)(s.lock_contended ? s.lock_wait.ns / s.lock_contended
+										: 0),
+		   (long long)(s.lock_hold.ns / s.lock_acquisitions));
+}
+
+// Threads repeatedly take lock around few writes to shared cache line,
+// as in critical sections of mpmc_stack and buckets_pool.
+template <typename Lock> uint64_t critical_section(uint64_t n, size_t threads)
+{
+	Lock lock;
+	concurrent::contention_counters contention;
+	uint64_t shared[4] = {};
+	const uint64_t per_thread = n / threads;
+	std::vector<std::vector<int64_t>> samples(threads);
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			bench::pin_thread(t);
+			for (uint64_t i = 0; i < per_thread; ++i) {
+				if ((i & LATENCY_SAMPLE_MASK) == 0) {
+					const int64_t start = concurrent::time::now().ns;
+					lock.lock();
+					samples[t].push_back(concurrent::time::now().ns - start);
+					lock.unlock();
+				}
+				concurrent::stat_lock_guard guard(lock, contention);
+				for (uint64_t &v : shared) {
+					++v;
+				}
+			}
+		});
+	}
+	for (std::thread &t : workers) {
+		t.join();
+	}
+	std::vector<int64_t> all;
+	for (std::vector<int64_t> &s : samples) {
+		all.insert(all.end(), s.begin(), s.end());
+	}
+	bench::print_percentiles("lock() wait", all);
+	print_contention(contention.snapshot());
+	bench::do_not_optimize(shared[0]);
+	return per_thread * threads;
+}
+
+// Popped nodes are pushed back, so poppers contend on stack lock.
+template <typename Lock> uint64_t mpmc_stack(uint64_t n, size_t threads)
+{
+	concurrent::mpmc::mpmc_stack<item, Lock> stack;
+	std::vector<item> nodes(threads * 64);
+	for (item &m : nodes) {
+		stack.push(&m);
+	}
+	const uint64_t per_thread = n / threads;
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			bench::pin_thread(t);
+			for (uint64_t i = 0; i < per_thread; ++i) {
+				item *m = stack.pop();
+				if (m != NULL) {
+					stack.push(m);
+				}
+			}
+		});
+	}
+	for (std::thread &t : workers) {
+		t.join();
+	}
+	print_contention(stack.get_contention_stats());
+	// Stack deletes nodes left in it on destruction.
+	stack.pop_all();
+	return per_thread * threads * 2;
+}
+
+template <typename Lock> void register_lock(const std::string &name)
+{
+	for (size_t threads : bench::thread_counts()) {
+		const std::string suffix = name + "/" + std::to_string(threads);
+		bench::registrar("lock/critical_section/" + suffix, 4'000'000,
+						 [threads](uint64_t n) {
+							 return critical_section<Lock>(n, threads);
+						 });
+		bench::registrar(
+			"lock/mpmc_stack/" + suffix, 4'000'000,
+			[threads](uint64_t n) { return mpmc_stack<Lock>(n, threads); });
+	}
+}
+
+struct registrations {
+	registrations()
+	{
+		register_lock<std::mutex>("std_mutex");
+		register_lock<concurrent::ttas_spinlock>("ttas_spinlock");
+		register_lock<concurrent::ticket_lock>("ticket_lock");
+		register_lock<concurrent::hybrid_mutex>("hybrid_mutex");
+	}
+} registrations;
+} // namespace
@@ -0,0 +1,191 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <thread>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "bench.hpp"
+
+namespace bench
+{
+namespace
+{
+struct percentiles {
+	std::string name;
+	long long p50, p99, p999, max;
+};
+
+struct result {
+	std::string name;
+	uint64_t ops;
+	int64_t ns;
+	std::vector<percentiles> latencies;
+};
+
+bool pin = false;
+std::vector<result> results;
+
+void write_json_string(FILE *f, const std::string &s)
+{
+	fputc('"', f);
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			fputc('\\', f);
+		}
+		fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+void write_json(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return;
+	}
+	fprintf(f, "{\"pinned\":%s,\"hardware_concurrency\":%u,\"results\":[",
+			pin ? "true" : "false", std::thread::hardware_concurrency());
+	for (size_t i = 0; i < results.size(); ++i) {
+		const result &r = results[i];
+		fprintf(f, "%s\n{\"name\":", i ? "," : "");
+		write_json_string(f, r.name);
+		fprintf(f, ",\"ops\":%llu,\"ns\":%lld,\"ns_per_op\":%.3f",
+				(unsigned long long)r.ops, (long long)r.ns,
+				r.ops ? (double)r.ns / (double)r.ops : 0.0);
+		fprintf(f, ",\"latencies\":[");
+		for (size_t j = 0; j < r.latencies.size(); ++j) {
+			const percentiles &p = r.latencies[j];
+			fprintf(f, "%s{\"name\":", j ? "," : "");
+			write_json_string(f, p.name);
+			fprintf(f, ",\"p50\":%lld,\"p99\":%lld,\"p999\":%lld,"
+					   "\"max\":%lld}",
+					p.p50, p.p99, p.p999, p.max);
+		}
+		fprintf(f, "]}");
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+}
+} // namespace
+
+std::vector<entry> &registry()
+{
+	static std::vector<entry> entries;
+	return entries;
+}
+
+std::vector<size_t> thread_counts()
+{
+	size_t max = std::thread::hardware_concurrency();
+	std::vector<size_t> counts;
+	for (size_t n = 1; n <= max || n == 1; n *= 2) {
+		counts.push_back(n);
+	}
+	if (max > 1 && counts.back() != max) {
+		counts.push_back(max);
+	}
+	return counts;
+}
+
+void print_percentiles(const char *name, std::vector<int64_t> &samples)
+{
+	if (samples.empty()) {
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	auto at = [&](double q) {
+		size_t i = (size_t)(q * (samples.size() - 1));
+		return (long long)samples[i];
+	};
+	printf("  %-38s p50 %lld ns  p99 %lld ns  p999 %lld ns  max %lld ns\n",
+		   name, at(0.5), at(0.99), at(0.999), (long long)samples.back());
+	if (results.empty() == false) {
+		results.back().latencies.push_back({name, at(0.5), at(0.99),
+											at(0.999),
+											(long long)samples.back()});
+	}
+}
+
+bool pinning_enabled() { return pin; }
+
+void pin_thread(size_t index)
+{
+	if (pin == false) {
+		return;
+	}
+#if defined(__linux__)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		return;
+	}
+	const int count = CPU_COUNT(&allowed);
+	if (count == 0) {
+		return;
+	}
+	int target = (int)(index % count);
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			return;
+		}
+	}
+#endif
+}
+} // namespace bench
+
+// Usage: concurrent_bench [--pin] [--json path] [name_substring...]
+int main(int argc, char **argv)
+{
+	const char *json_path = NULL;
+	std::vector<const char *> filters;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--pin") == 0) {
+			bench::pin = true;
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else {
+			filters.push_back(argv[i]);
+		}
+	}
+	for (const bench::entry &e : bench::registry()) {
+		bool selected = filters.empty();
+		for (const char *filter : filters) {
+			if (strstr(e.name.c_str(), filter) != NULL) {
+				selected = true;
+			}
+		}
+		if (!selected) {
+			continue;
+		}
+		bench::results.push_back({e.name, 0, 0, {}});
+		concurrent::time::point begin = concurrent::time::now();
+		uint64_t ops = e.func(e.iterations);
+		concurrent::time::diff dt = concurrent::time::now() - begin;
+		bench::results.back().ops = ops;
+		bench::results.back().ns = dt.ns;
+		double ns_per_op = ops ? (double)dt.ns / (double)ops : 0.0;
+		double mops = dt.ns ? (double)ops * 1000.0 / (double)dt.ns : 0.0;
+		printf("%-40s %12llu ops %10.2f ns/op %10.3f Mops/s\n", e.name.c_str(),
+			   (unsigned long long)ops, ns_per_op, mops);
+	}
+	if (json_path != NULL) {
+		bench::write_json(json_path);
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "../parallel.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+std::vector<uint64_t> random_values(uint64_t n)
+{
+	std::vector<uint64_t> v(n);
+	std::mt19937_64 rng(n);
+	for (uint64_t &x : v) {
+		x = rng();
+	}
+	return v;
+}
+
+struct registrations {
+	registrations()
+	{
+		bench::registrar("parallel/std_sort", 10'000'000, [](uint64_t n) {
+			std::vector<uint64_t> v = random_values(n);
+			std::sort(v.begin(), v.end());
+			return n;
+		});
+
+		for (size_t threads : bench::thread_counts()) {
+			std::string suffix = "/" + std::to_string(threads);
+
+			bench::registrar(
+				"parallel/sort" + suffix, 10'000'000, [threads](uint64_t n) {
+					concurrent::executor ex(threads);
+					std::vector<uint64_t> v = random_values(n);
+					concurrent::parallel_sort(ex, v.begin(), v.end()).wait();
+					return n;
+				});
+
+			bench::registrar(
+				"parallel/reduce" + suffix, 50'000'000, [threads](uint64_t n) {
+					concurrent::executor ex(threads);
+					std::vector<uint64_t> v(n, 1);
+					uint64_t sum = concurrent::parallel_reduce(
+									   ex, v.begin(), v.end(), (uint64_t)0,
+									   std::plus<>())
+									   .get();
+					bench::do_not_optimize(sum);
+					return n;
+				});
+		}
+	}
+} registrations_instance;
+} // namespace
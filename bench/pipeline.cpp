@@ -0,0 +1,88 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../pipeline.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+constexpr size_t batches[] = {1, 16, 64};
+
+using event = bench::payload<64>;
+
+void print_stats(const std::vector<concurrent::stage_stats> &stats)
+{
+	for (const concurrent::stage_stats &s : stats) {
+		printf("  %-10s %8.3f Mitems/s batches %llu input_waits %llu "
+			   "output_waits %llu\n",
+			   s.name.c_str(), s.throughput / 1e6,
+			   (unsigned long long)s.batches,
+			   (unsigned long long)s.input_waits,
+			   (unsigned long long)s.output_waits);
+	}
+}
+
+// Source, two copying stages and sink, every stage on own thread (pinned
+// with --pin).
+uint64_t stages(uint64_t n, size_t batch)
+{
+	auto *a = new concurrent::channel<event>();
+	auto *b = new concurrent::channel<event>();
+	auto *c = new concurrent::channel<event>();
+	const int pin = bench::pinning_enabled() ? 0 : -1;
+	uint64_t produced = 0, sum = 0;
+	{
+		concurrent::pipeline p(batch);
+		p.add_source(
+			"source",
+			[&](event &e) {
+				e.value = produced;
+				return produced++ < n;
+			},
+			*a, pin);
+		p.add_stage(
+			"copy1", *a,
+			[](event &in, event &out) {
+				out = in;
+				return true;
+			},
+			*b, pin < 0 ? -1 : 1);
+		p.add_stage(
+			"copy2", *b,
+			[](event &in, event &out) {
+				out = in;
+				++out.value;
+				return true;
+			},
+			*c, pin < 0 ? -1 : 2);
+		p.add_sink(
+			"sink", *c, [&](event &e) { sum += e.value; }, pin < 0 ? -1 : 3);
+		p.start();
+		p.join();
+		print_stats(p.stats());
+	}
+	bench::do_not_optimize(sum);
+	delete a;
+	delete b;
+	delete c;
+	return n;
+}
+
+struct registrations {
+	registrations()
+	{
+		for (size_t batch : batches) {
+			bench::registrar("pipeline/4_stages/batch_" + std::to_string(batch),
+							 2'000'000,
+							 [batch](uint64_t n) { return stages(n, batch); });
+		}
+	}
+} registrations;
+} // namespace
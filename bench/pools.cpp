@@ -0,0 +1,96 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../object_pool.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+// Each thread allocates BATCH objects, touches them and frees them, which
+// forces thread_local_pool to trade buckets with global pool.
+constexpr size_t BATCH = 512;
+
+template <typename A, typename F>
+uint64_t run_batches(uint64_t n, size_t threads, A &&alloc, F &&free_fn)
+{
+	const uint64_t per_thread = (n / threads / BATCH) * BATCH;
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			bench::pin_thread(t);
+			std::vector<void *> batch(BATCH);
+			for (uint64_t i = 0; i < per_thread; i += BATCH) {
+				for (size_t j = 0; j < BATCH; ++j) {
+					batch[j] = alloc();
+					*(uint64_t *)batch[j] = j;
+				}
+				for (size_t j = 0; j < BATCH; ++j) {
+					free_fn(batch[j]);
+				}
+			}
+		});
+	}
+	for (std::thread &t : workers) {
+		t.join();
+	}
+	return per_thread * threads;
+}
+
+template <size_t BYTES> uint64_t thread_cached_pool(uint64_t n, size_t threads)
+{
+	using pool = concurrent::thread_cached_pool<BYTES < 16 ? 16 : BYTES>;
+	return run_batches(
+		n, threads, []() { return pool::allocate(); },
+		[](void *p) { pool::deallocate(p); });
+}
+
+template <size_t BYTES> uint64_t object_pool(uint64_t n, size_t threads)
+{
+	using pool = concurrent::object_pool<bench::payload<BYTES>>;
+	return run_batches(
+		n, threads, []() { return (void *)pool::acquire_raw(); },
+		[](void *p) { pool::release((bench::payload<BYTES> *)p); });
+}
+
+template <size_t BYTES> uint64_t baseline_malloc(uint64_t n, size_t threads)
+{
+	return run_batches(
+		n, threads, []() { return malloc(BYTES); }, [](void *p) { free(p); });
+}
+
+template <size_t BYTES> void register_sized()
+{
+	const std::string size = "/" + std::to_string(BYTES) + "B";
+	for (size_t threads : bench::thread_counts()) {
+		const std::string suffix = size + "/" + std::to_string(threads);
+		bench::registrar("pool/thread_cached_pool" + suffix, 10'000'000,
+						 [threads](uint64_t n) {
+							 return thread_cached_pool<BYTES>(n, threads);
+						 });
+		bench::registrar(
+			"pool/object_pool" + suffix, 10'000'000,
+			[threads](uint64_t n) { return object_pool<BYTES>(n, threads); });
+		bench::registrar("baseline/malloc" + suffix, 10'000'000,
+						 [threads](uint64_t n) {
+							 return baseline_malloc<BYTES>(n, threads);
+						 });
+	}
+}
+
+struct registrations {
+	registrations()
+	{
+		register_sized<8>();
+		register_sized<64>();
+		register_sized<256>();
+	}
+} registrations;
+} // namespace
@@ -0,0 +1,317 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../spsc_ringbuffer.hpp"
+#include "../mpsc_stack.hpp"
+#include "../mpsc_queue.hpp"
+#include "../mpmc_stack.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+// Every LATENCY_SAMPLE_MASK+1-th message carries send timestamp.
+constexpr uint64_t LATENCY_SAMPLE_MASK = 63;
+
+// Copied by value through ringbuffer and baseline deque.
+template <size_t BYTES> struct message {
+	bench::payload<BYTES> data;
+	int64_t sent = 0;
+};
+
+// Linked by pointer through node based structures.
+template <size_t BYTES>
+struct message_node : concurrent::node<message_node<BYTES>> {
+	bench::payload<BYTES> data;
+	int64_t sent = 0;
+};
+
+// Runs producers and consumers each in own (optionally pinned) thread,
+// consumers first.
+template <typename P, typename C>
+void run_threads(size_t producers, size_t consumers, P &&producer,
+				 C &&consumer)
+{
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < consumers; ++i) {
+		threads.emplace_back([&, i]() {
+			bench::pin_thread(i);
+			consumer(i);
+		});
+	}
+	for (size_t i = 0; i < producers; ++i) {
+		threads.emplace_back([&, i]() {
+			bench::pin_thread(consumers + i);
+			producer(i);
+		});
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+}
+
+inline void stamp(uint64_t i, int64_t &sent)
+{
+	sent = (i & LATENCY_SAMPLE_MASK) == 0 ? concurrent::time::now().ns : 0;
+}
+
+inline void sample(int64_t sent, std::vector<int64_t> &samples)
+{
+	if (sent != 0) {
+		samples.push_back(concurrent::time::now().ns - sent);
+	}
+}
+
+// Baseline for all queues.
+template <typename T> class mutex_deque
+{
+public:
+	void push(const T &v)
+	{
+		std::lock_guard lock(mutex);
+		deque.push_back(v);
+	}
+	bool pop(T &v)
+	{
+		std::lock_guard lock(mutex);
+		if (deque.empty()) {
+			return false;
+		}
+		v = deque.front();
+		deque.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex mutex;
+	std::deque<T> deque;
+};
+
+template <size_t BYTES> uint64_t spsc_ringbuffer(uint64_t n)
+{
+	using msg = message<BYTES>;
+	static concurrent::spsc::ringbuffer<msg, 1024> ring;
+	std::vector<int64_t> samples;
+	run_threads(
+		1, 1,
+		[&](size_t) {
+			msg m;
+			for (uint64_t i = 0; i < n; ++i) {
+				m.data.value = i;
+				stamp(i, m.sent);
+				while (ring.push(m) == false) {
+					std::this_thread::yield();
+				}
+			}
+		},
+		[&](size_t) {
+			msg m;
+			for (uint64_t i = 0; i < n;) {
+				if (ring.pop(m)) {
+					sample(m.sent, samples);
+					++i;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	bench::print_percentiles("enqueue -> dequeue", samples);
+	return n;
+}
+
+template <size_t BYTES>
+uint64_t baseline_queue(uint64_t n, size_t producers)
+{
+	using msg = message<BYTES>;
+	mutex_deque<msg> queue;
+	std::vector<int64_t> samples;
+	const uint64_t per_producer = n / producers;
+	run_threads(
+		producers, 1,
+		[&](size_t) {
+			msg m;
+			for (uint64_t i = 0; i < per_producer; ++i) {
+				m.data.value = i;
+				stamp(i, m.sent);
+				queue.push(m);
+			}
+		},
+		[&](size_t) {
+			msg m;
+			for (uint64_t i = 0; i < per_producer * producers;) {
+				if (queue.pop(m)) {
+					sample(m.sent, samples);
+					++i;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	bench::print_percentiles("enqueue -> dequeue", samples);
+	return per_producer * producers;
+}
+
+// Nodes are preallocated, so only the structure itself is measured.
+template <size_t BYTES> uint64_t mpsc_queue(uint64_t n, size_t producers)
+{
+	using msg = message_node<BYTES>;
+	concurrent::mpsc::queue<msg> queue;
+	const uint64_t per_producer = n / producers;
+	std::vector<msg> nodes(per_producer * producers);
+	std::vector<int64_t> samples;
+	run_threads(
+		producers, 1,
+		[&](size_t p) {
+			for (uint64_t i = 0; i < per_producer; ++i) {
+				msg *m = &nodes[p * per_producer + i];
+				m->data.value = i;
+				stamp(i, m->sent);
+				queue.push(m);
+			}
+		},
+		[&](size_t) {
+			for (uint64_t i = 0; i < per_producer * producers;) {
+				if (msg *m = queue.pop()) {
+					sample(m->sent, samples);
+					++i;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	bench::print_percentiles("enqueue -> dequeue", samples);
+	return per_producer * producers;
+}
+
+template <size_t BYTES> uint64_t mpsc_stack(uint64_t n, size_t producers)
+{
+	using msg = message_node<BYTES>;
+	concurrent::mpsc::stack<msg> stack;
+	const uint64_t per_producer = n / producers;
+	std::vector<msg> nodes(per_producer * producers);
+	run_threads(
+		producers, 1,
+		[&](size_t p) {
+			for (uint64_t i = 0; i < per_producer; ++i) {
+				stack.push(&nodes[p * per_producer + i]);
+			}
+		},
+		[&](size_t) {
+			for (uint64_t i = 0; i < per_producer * producers;) {
+				msg *m = stack.pop_all();
+				if (m == NULL) {
+					std::this_thread::yield();
+				}
+				for (; m != NULL; m = m->__m_next.load()) {
+					++i;
+				}
+			}
+		});
+	return per_producer * producers;
+}
+
+// Equal number of pushing and popping threads, popped nodes are pushed back
+// so the stack never drains.
+template <size_t BYTES> uint64_t mpmc_stack(uint64_t n, size_t threads)
+{
+	using msg = message_node<BYTES>;
+	concurrent::mpmc::mpmc_stack<msg> stack;
+	std::vector<msg> nodes(threads * 64);
+	for (msg &m : nodes) {
+		stack.push(&m);
+	}
+	const uint64_t per_thread = n / threads;
+	run_threads(threads, 0,
+				[&](size_t) {
+					for (uint64_t i = 0; i < per_thread; ++i) {
+						msg *m = stack.pop();
+						if (m == NULL) {
+							std::this_thread::yield();
+							continue;
+						}
+						stack.push(m);
+					}
+				},
+				[](size_t) {});
+	// Stack deletes nodes left in it on destruction.
+	stack.pop_all();
+	return per_thread * threads * 2;
+}
+
+template <size_t BYTES> uint64_t baseline_stack(uint64_t n, size_t threads)
+{
+	using msg = message_node<BYTES>;
+	std::mutex mutex;
+	std::vector<msg *> stack;
+	std::vector<msg> nodes(threads * 64);
+	for (msg &m : nodes) {
+		stack.push_back(&m);
+	}
+	const uint64_t per_thread = n / threads;
+	run_threads(threads, 0,
+				[&](size_t) {
+					for (uint64_t i = 0; i < per_thread; ++i) {
+						msg *m;
+						{
+							std::lock_guard lock(mutex);
+							m = stack.back();
+							stack.pop_back();
+						}
+						bench::do_not_optimize(m);
+						std::lock_guard lock(mutex);
+						stack.push_back(m);
+					}
+				},
+				[](size_t) {});
+	return per_thread * threads * 2;
+}
+
+template <size_t BYTES> void register_sized()
+{
+	const std::string size = "/" + std::to_string(BYTES) + "B";
+	bench::registrar("spsc_ringbuffer" + size, 2'000'000,
+					 spsc_ringbuffer<BYTES>);
+	for (size_t threads : bench::thread_counts()) {
+		const std::string suffix = size + "/" + std::to_string(threads);
+		bench::registrar(
+			"mpsc_queue" + suffix, 2'000'000,
+			[threads](uint64_t n) { return mpsc_queue<BYTES>(n, threads); });
+		bench::registrar(
+			"mpsc_stack" + suffix, 2'000'000,
+			[threads](uint64_t n) { return mpsc_stack<BYTES>(n, threads); });
+		bench::registrar("baseline/mutex_deque" + suffix, 2'000'000,
+						 [threads](uint64_t n) {
+							 return baseline_queue<BYTES>(n, threads);
+						 });
+		bench::registrar(
+			"mpmc_stack" + suffix, 2'000'000,
+			[threads](uint64_t n) { return mpmc_stack<BYTES>(n, threads); });
+		bench::registrar("baseline/mutex_vector_stack" + suffix, 2'000'000,
+						 [threads](uint64_t n) {
+							 return baseline_stack<BYTES>(n, threads);
+						 });
+	}
+}
+
+struct registrations {
+	registrations()
+	{
+		static_assert(bench::payload_sizes[0] == 8 &&
+						  bench::payload_sizes[1] == 64 &&
+						  bench::payload_sizes[2] == 256,
+					  "update register_sized calls");
+		register_sized<8>();
+		register_sized<64>();
+		register_sized<256>();
+	}
+} registrations;
+} // namespace
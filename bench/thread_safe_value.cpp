@@ -0,0 +1,214 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../thread_safe_value.hpp"
+
+#include "bench.hpp"
+
+namespace
+{
+// Every thread does 1 write per write_every operations, rest are reads.
+// WRITE_EVERY is update heavy mix, READ_MOSTLY_WRITE_EVERY measures scaling
+// of readers.
+constexpr uint64_t WRITE_EVERY = 16;
+constexpr uint64_t READ_MOSTLY_WRITE_EVERY = 1024;
+
+template <typename R, typename W>
+uint64_t run_mix(uint64_t n, size_t threads, uint64_t write_every, R &&read,
+				 W &&write)
+{
+	const uint64_t per_thread = n / threads;
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			bench::pin_thread(t);
+			uint64_t sum = 0;
+			for (uint64_t i = 0; i < per_thread; ++i) {
+				if (i % write_every == 0) {
+					write(i);
+				} else {
+					sum += read();
+				}
+			}
+			bench::do_not_optimize(sum);
+		});
+	}
+	for (std::thread &t : workers) {
+		t.join();
+	}
+	return per_thread * threads;
+}
+
+template <size_t BYTES, typename Policy>
+uint64_t thread_safe_value(uint64_t n, size_t threads, uint64_t write_every)
+{
+	using T = bench::payload<BYTES>;
+	concurrent::thread_safe_value<T, Policy> value{T{}};
+	return run_mix(
+		n, threads, write_every, [&]() { return ((T)value).value; },
+		[&](uint64_t i) {
+			T v{};
+			v.value = i;
+			value = v;
+		});
+}
+
+template <size_t BYTES>
+uint64_t baseline_mutex(uint64_t n, size_t threads, uint64_t write_every)
+{
+	using T = bench::payload<BYTES>;
+	std::mutex mutex;
+	T value{};
+	return run_mix(
+		n, threads, write_every,
+		[&]() {
+			std::lock_guard lock(mutex);
+			T copy = value;
+			return copy.value;
+		},
+		[&](uint64_t i) {
+			std::lock_guard lock(mutex);
+			value.value = i;
+		});
+}
+
+// Every operation updates value, through begin_access()/end_access() or
+// flat combining apply().
+template <size_t BYTES, typename Policy>
+uint64_t update_access(uint64_t n, size_t threads)
+{
+	using T = bench::payload<BYTES>;
+	concurrent::thread_safe_value<T, Policy> value{T{}};
+	return run_mix(
+		n, threads, 1, []() { return 0; },
+		[&](uint64_t) {
+			value.begin_access();
+			++value->value;
+			value.end_access();
+		});
+}
+
+template <size_t BYTES, typename Policy>
+uint64_t update_apply(uint64_t n, size_t threads)
+{
+	using T = bench::payload<BYTES>;
+	concurrent::thread_safe_value<T, Policy> value{T{}};
+	return run_mix(
+		n, threads, 1, []() { return 0; },
+		[&](uint64_t) { value.apply([](T &v) { ++v.value; }); });
+}
+
+template <size_t BYTES, typename Policy>
+void register_policy(const std::string &name, const std::string &suffix,
+					 size_t threads)
+{
+	bench::registrar("thread_safe_value/" + name + suffix, 10'000'000,
+					 [threads](uint64_t n) {
+						 return thread_safe_value<BYTES, Policy>(n, threads,
+																WRITE_EVERY);
+					 });
+	bench::registrar("thread_safe_value/" + name + "/read_mostly" + suffix,
+					 10'000'000, [threads](uint64_t n) {
+						 return thread_safe_value<BYTES, Policy>(
+							 n, threads, READ_MOSTLY_WRITE_EVERY);
+					 });
+	bench::registrar("thread_safe_value/" + name + "/update_access" + suffix,
+					 2'000'000, [threads](uint64_t n) {
+						 return update_access<BYTES, Policy>(n, threads);
+					 });
+	bench::registrar("thread_safe_value/" + name + "/update_apply" + suffix,
+					 2'000'000, [threads](uint64_t n) {
+						 return update_apply<BYTES, Policy>(n, threads);
+					 });
+}
+
+template <size_t BYTES> void register_sized()
+{
+	namespace policy = concurrent::thread_safe_value_policy;
+	const std::string size = "/" + std::to_string(BYTES) + "B";
+	for (size_t threads : bench::thread_counts()) {
+		const std::string suffix = size + "/" + std::to_string(threads);
+		register_policy<BYTES, policy::mutex>("mutex", suffix, threads);
+		register_policy<BYTES, policy::seqlock>("seqlock", suffix, threads);
+		register_policy<BYTES, policy::rcu>("rcu", suffix, threads);
+		bench::registrar("baseline/mutex_value" + suffix, 10'000'000,
+						 [threads](uint64_t n) {
+							 return baseline_mutex<BYTES>(n, threads,
+														  WRITE_EVERY);
+						 });
+		bench::registrar("baseline/mutex_value/read_mostly" + suffix,
+						 10'000'000, [threads](uint64_t n) {
+							 return baseline_mutex<BYTES>(
+								 n, threads, READ_MOSTLY_WRITE_EVERY);
+						 });
+	}
+}
+
+// Routing table style: lookups in large map, which is rarely replaced.
+using table = std::map<uint64_t, uint64_t>;
+constexpr uint64_t TABLE_SIZE = 1024;
+constexpr uint64_t TABLE_WRITE_EVERY = 1 << 16;
+
+table make_table(uint64_t version)
+{
+	table t;
+	for (uint64_t i = 0; i < TABLE_SIZE; ++i) {
+		t[i] = i + version;
+	}
+	return t;
+}
+
+// With mutex policy lookup is done under lock instead of copying map.
+uint64_t table_mutex(uint64_t n, size_t threads)
+{
+	using namespace concurrent::thread_safe_value_policy;
+	concurrent::thread_safe_value<table, mutex> value(make_table(0));
+	return run_mix(
+		n, threads, TABLE_WRITE_EVERY,
+		[&, key = (uint64_t)0]() mutable {
+			value.begin_access();
+			const uint64_t v = value->find(++key % TABLE_SIZE)->second;
+			value.end_access();
+			return v;
+		},
+		[&](uint64_t i) { value = make_table(i); });
+}
+
+uint64_t table_rcu(uint64_t n, size_t threads)
+{
+	using namespace concurrent::thread_safe_value_policy;
+	concurrent::thread_safe_value<table, rcu> value(make_table(0));
+	return run_mix(
+		n, threads, TABLE_WRITE_EVERY,
+		[&, key = (uint64_t)0]() mutable {
+			return value.read()->find(++key % TABLE_SIZE)->second;
+		},
+		[&](uint64_t i) { value = make_table(i); });
+}
+
+struct registrations {
+	registrations()
+	{
+		for (size_t threads : bench::thread_counts()) {
+			const std::string suffix = "/" + std::to_string(threads);
+			bench::registrar(
+				"thread_safe_value/mutex/map_lookup" + suffix, 1'000'000,
+				[threads](uint64_t n) { return table_mutex(n, threads); });
+			bench::registrar(
+				"thread_safe_value/rcu/map_lookup" + suffix, 1'000'000,
+				[threads](uint64_t n) { return table_rcu(n, threads); });
+		}
+		register_sized<8>();
+		register_sized<64>();
+		register_sized<256>();
+	}
+} registrations;
+} // namespace
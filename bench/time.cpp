@@ -0,0 +1,61 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+#include <chrono>
+
+#include "../time.hpp"
+
+#include "bench.hpp"
+
+BENCHMARK("time/steady_clock", 20'000'000, [](uint64_t n) {
+	int64_t sum = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		sum += std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+BENCHMARK("time/now", 20'000'000, [](uint64_t n) {
+	int64_t sum = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		sum += concurrent::time::now().ns;
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+BENCHMARK("time/now_fast", 20'000'000, [](uint64_t n) {
+	int64_t sum = concurrent::time::now_fast().ns;
+	for (uint64_t i = 0; i < n; ++i) {
+		sum += concurrent::time::now_fast().ns;
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+BENCHMARK("time/now_coarse", 20'000'000, [](uint64_t n) {
+	int64_t sum = concurrent::time::now_coarse().ns;
+	for (uint64_t i = 0; i < n; ++i) {
+		sum += concurrent::time::now_coarse().ns;
+	}
+	bench::do_not_optimize(sum);
+	return n;
+});
+
+// Largest difference between now_fast() and now() sampled back to back.
+BENCHMARK("time/now_fast_error", 1'000, [](uint64_t n) {
+	int64_t worst = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		const int64_t a = concurrent::time::now_fast().ns;
+		const int64_t b = concurrent::time::now().ns;
+		const int64_t d = a > b ? a - b : b - a;
+		worst = d > worst ? d : worst;
+		concurrent::time::sleep_for(concurrent::time::microseconds(100));
+	}
+	printf("%-40s %12lld ns max error\n", "time/now_fast_error", (long long)worst);
+	return n;
+});
@@ -0,0 +1,106 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../timer_wheel.hpp"
+
+#include "bench.hpp"
+
+using concurrent::timer_wheel;
+
+// Typical request timeout: scheduled and cancelled before it ever fires.
+BENCHMARK("timer_wheel/schedule_cancel", 5'000'000, [](uint64_t n) {
+	timer_wheel wheel(concurrent::time::milliseconds(1), concurrent::time::point{0});
+	uint64_t cancelled = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		timer_wheel::timer t = wheel.schedule(
+			concurrent::time::point{(int64_t)(30'000'000'000ll + i)}, []() {});
+		cancelled += t.cancel();
+		if ((i & 1023) == 0) {
+			wheel.advance(concurrent::time::point{(int64_t)i});
+		}
+	}
+	wheel.advance(concurrent::time::point{(int64_t)n});
+	bench::do_not_optimize(cancelled);
+	return n;
+});
+
+// Timers spread over 60 s expired by advancing time in 1 ms steps, includes
+// cascades from upper levels.
+BENCHMARK("timer_wheel/schedule_expire", 5'000'000, [](uint64_t n) {
+	timer_wheel wheel(concurrent::time::milliseconds(1), concurrent::time::point{0});
+	uint64_t fired = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		wheel.schedule(concurrent::time::point{(int64_t)((i * 7919) % 60'000) * 1'000'000},
+					   [&fired]() { ++fired; });
+	}
+	for (int64_t ms = 0; ms <= 60'000; ++ms) {
+		wheel.advance(concurrent::time::point{ms * 1'000'000});
+	}
+	bench::do_not_optimize(fired);
+	return fired;
+});
+
+BENCHMARK("timer_wheel/fail_on_timeout", 2'000'000, [](uint64_t n) {
+	timer_wheel wheel(concurrent::time::milliseconds(1), concurrent::time::point{0});
+	uint64_t ok = 0;
+	for (uint64_t i = 0; i < n; ++i) {
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		timer_wheel::timer t =
+			wheel.fail_on_timeout(f, concurrent::time::point{1'000'000'000});
+		ok += p.try_set_value(i);
+		t.cancel();
+		if ((i & 1023) == 0) {
+			wheel.advance(concurrent::time::point{(int64_t)i});
+		}
+	}
+	bench::do_not_optimize(ok);
+	return n;
+});
+
+namespace
+{
+struct registrations {
+	registrations()
+	{
+		for (size_t threads : bench::thread_counts()) {
+			// Producers scheduling concurrently through lock-free stack while
+			// owner thread keeps draining it.
+			bench::registrar(
+				"timer_wheel/mp_schedule/" + std::to_string(threads), 4'000'000,
+				[threads](uint64_t n) {
+					timer_wheel wheel(concurrent::time::milliseconds(1), concurrent::time::point{0});
+					std::atomic<size_t> done = 0;
+					std::vector<std::thread> producers;
+					const uint64_t per_thread = n / threads;
+					for (size_t t = 0; t < threads; ++t) {
+						producers.emplace_back([&, t]() {
+							for (uint64_t i = 0; i < per_thread; ++i) {
+								wheel.schedule(
+									concurrent::time::point{(int64_t)(i % 10'000) *
+												1'000'000},
+									[]() {});
+							}
+							done.fetch_add(1);
+						});
+					}
+					while (done.load() < threads) {
+						wheel.advance(concurrent::time::point{0});
+					}
+					for (std::thread &t : producers) {
+						t.join();
+					}
+					wheel.advance(concurrent::time::point{10'000'000'000ll});
+					return per_thread * threads;
+				});
+		}
+	}
+} registrations;
+} // namespace
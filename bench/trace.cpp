@@ -0,0 +1,46 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#include <cstdio>
+
+#include "../trace.hpp"
+
+#include "bench.hpp"
+
+BENCHMARK("trace/disabled", 50'000'000, [](uint64_t n) {
+	for (uint64_t i = 0; i < n; ++i) {
+		concurrent::trace::instant("disabled");
+	}
+	return n;
+});
+
+// begin/end pairs in batches smaller than per-thread buffer, drained by
+// collector into /dev/null between batches. Total includes JSON export,
+// recording alone is printed separately.
+BENCHMARK("trace/scope", 2'000'000, [](uint64_t n) {
+	FILE *f = fopen("/dev/null", "w");
+	uint64_t done = 0;
+	concurrent::time::diff recording;
+	{
+		concurrent::trace::collector c(f, concurrent::time::milliseconds(1));
+		while (done < n) {
+			const concurrent::time::point start = concurrent::time::now();
+			for (int i = 0; i < 1024; ++i) {
+				concurrent::trace::scope s("scope");
+			}
+			recording += concurrent::time::now() - start;
+			done += 1024;
+			c.flush();
+		}
+		if (c.count_dropped_events() != 0) {
+			printf("  trace/scope dropped %llu events\n",
+				   (unsigned long long)c.count_dropped_events());
+		}
+	}
+	fclose(f);
+	printf("  trace/scope recording only %.2f ns/event\n",
+		   recording.ns / (double)(done * 2));
+	return done * 2;
+});
@@ -0,0 +1,431 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_BROADCAST_RING_HPP
+#define CONCURRENT_BROADCAST_RING_HPP
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <atomic>
+#include <bit>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#include "backoff.hpp"
+#include "futex.hpp"
+
+namespace concurrent
+{
+//	Disruptor style broadcast ring. Producers claim sequence numbers, fill
+//	preallocated slots in place and publish them. Every consumer reads every
+//	published slot in place and advances its own sequence, so nothing is
+//	copied per consumer. Consumers form dependency graph through barriers:
+//	consumer of later stage waits also for sequences of consumers it depends
+//	on, which may annotate slots for it. Producers do not reuse slot until
+//	all gating sequences (consumers of last stage) released it.
+namespace broadcast
+{
+//	Last sequence processed by consumer, on own cache line.
+class alignas(64) sequence
+{
+public:
+	static constexpr int64_t INITIAL = -1;
+
+	inline int64_t get() const {
+		return value.load(std::memory_order_acquire);
+	}
+
+	//	Releases slots up to v to producers and dependent consumers.
+	inline void set(int64_t v) {
+		value.store(v, std::memory_order_release);
+	}
+
+private:
+	std::atomic<int64_t> value = INITIAL;
+};
+
+//	Wait strategies, Wait parameter of ring. wait_for() returns value of
+//	available() once it reaches seq, cursor is highest claimed sequence.
+//	notify() is called after every publish.
+
+//	Spins with cpu_relax(), lowest latency, needs own core per consumer.
+class busy_spin_wait
+{
+public:
+	template<typename F>
+	inline int64_t wait_for(int64_t seq, const std::atomic<int64_t> &,
+			F &&available) {
+		int64_t a;
+		while ((a = available()) < seq) {
+			cpu_relax();
+		}
+		return a;
+	}
+
+	inline void notify() {}
+};
+
+//	Spins SPIN_TRIES times, then yields before every check.
+class yielding_wait
+{
+public:
+	static constexpr uint32_t SPIN_TRIES = 100;
+
+	template<typename F>
+	inline int64_t wait_for(int64_t seq, const std::atomic<int64_t> &,
+			F &&available) {
+		int64_t a;
+		for (uint32_t i = 0; (a = available()) < seq; ++i) {
+			if (i < SPIN_TRIES) {
+				cpu_relax();
+			} else {
+				std::this_thread::yield();
+			}
+		}
+		return a;
+	}
+
+	inline void notify() {}
+};
+
+//	Sleeps in futex until seq is claimed, then backs off until it is
+//	published and processed by dependencies, which is expected shortly.
+//	Publish enters kernel only when some consumer sleeps. Consumer sleeping
+//	here can be stopped only by publishing, so shut down with sentinel
+//	value. Requires linking futex.cpp.
+class blocking_wait
+{
+public:
+	template<typename F>
+	inline int64_t wait_for(int64_t seq, const std::atomic<int64_t> &cursor,
+			F &&available) {
+		if (cursor.load(std::memory_order_acquire) < seq) {
+			waiters.fetch_add(1, std::memory_order_seq_cst);
+			for (;;) {
+				const uint32_t s = signal.load(std::memory_order_seq_cst);
+				if (cursor.load(std::memory_order_seq_cst) >= seq) {
+					break;
+				}
+				futex::wait(&signal, s);
+			}
+			waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+		exponential_backoff backoff;
+		int64_t a;
+		while ((a = available()) < seq) {
+			backoff.pause();
+		}
+		return a;
+	}
+
+	inline void notify() {
+		// Pairs with increment of waiters: either publisher sees sleeper or
+		// sleeper sees new cursor.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_relaxed) != 0) {
+			signal.fetch_add(1, std::memory_order_seq_cst);
+			futex::wake_all(&signal);
+		}
+	}
+
+private:
+	std::atomic<uint32_t> signal = 0;
+	std::atomic<uint32_t> waiters = 0;
+};
+
+//	Producer policies, Producer parameter of ring.
+struct single_producer {};
+struct multi_producer {};
+
+namespace detail
+{
+inline int64_t minimum_sequence(const std::vector<const sequence *> &seqs,
+		int64_t minimum) {
+	for (const sequence *s : seqs) {
+		const int64_t v = s->get();
+		if (v < minimum) {
+			minimum = v;
+		}
+	}
+	return minimum;
+}
+
+template<typename Producer, size_t SIZE>
+class sequencer;
+
+//	Claiming touches only producer owned fields, cursor is both highest
+//	claimed and highest published sequence.
+template<size_t SIZE>
+class sequencer<single_producer, SIZE>
+{
+public:
+	//	Full ring means slowest consumer is whole ring behind, so claim() spins
+	//	only briefly before yielding to it.
+	inline int64_t claim(size_t n, const std::vector<const sequence *> &gating) {
+		const int64_t next = claimed + (int64_t)n;
+		if (next - (int64_t)SIZE > cached_gating) {
+			spin_then_yield_backoff backoff;
+			while (next - (int64_t)SIZE >
+					(cached_gating = minimum_sequence(gating, claimed))) {
+				backoff.pause();
+			}
+		}
+		claimed = next;
+		return next - (int64_t)n + 1;
+	}
+
+	inline bool try_claim(size_t n, const std::vector<const sequence *> &gating,
+			int64_t &first) {
+		const int64_t next = claimed + (int64_t)n;
+		if (next - (int64_t)SIZE > cached_gating &&
+				next - (int64_t)SIZE >
+					(cached_gating = minimum_sequence(gating, claimed))) {
+			return false;
+		}
+		claimed = next;
+		first = next - (int64_t)n + 1;
+		return true;
+	}
+
+	inline void publish(int64_t first, size_t n) {
+		_cursor.store(first + (int64_t)n - 1, std::memory_order_release);
+	}
+
+	inline int64_t highest_published(int64_t, int64_t available) const {
+		return available;
+	}
+
+	inline const std::atomic<int64_t> &cursor() const {
+		return _cursor;
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> _cursor = sequence::INITIAL;
+	//	Touched only by producer.
+	alignas(64) int64_t claimed = sequence::INITIAL;
+	int64_t cached_gating = sequence::INITIAL;
+};
+
+//	Producers claim with CAS on cursor and publish every slot separately by
+//	storing its round number (sequence / SIZE), so consumer finds highest
+//	contiguous published sequence even when later claims finish first.
+template<size_t SIZE>
+class sequencer<multi_producer, SIZE>
+{
+public:
+	static constexpr int SHIFT = std::countr_zero(SIZE);
+
+	sequencer() {
+		for (std::atomic<int64_t> &p : published) {
+			p.store(-1, std::memory_order_relaxed);
+		}
+	}
+
+	inline int64_t claim(size_t n, const std::vector<const sequence *> &gating) {
+		int64_t first;
+		spin_then_yield_backoff backoff;
+		while (_internal_claim(n, gating, first) == false) {
+			backoff.pause();
+		}
+		return first;
+	}
+
+	inline bool try_claim(size_t n, const std::vector<const sequence *> &gating,
+			int64_t &first) {
+		return _internal_claim(n, gating, first);
+	}
+
+	inline void publish(int64_t first, size_t n) {
+		for (int64_t s = first; s < first + (int64_t)n; ++s) {
+			published[s & (SIZE - 1)].store(s >> SHIFT,
+					std::memory_order_release);
+		}
+	}
+
+	inline int64_t highest_published(int64_t seq, int64_t available) const {
+		for (int64_t s = seq; s <= available; ++s) {
+			if (published[s & (SIZE - 1)].load(std::memory_order_acquire) !=
+					(s >> SHIFT)) {
+				return s - 1;
+			}
+		}
+		return available;
+	}
+
+	inline const std::atomic<int64_t> &cursor() const {
+		return claimed;
+	}
+
+private:
+	// Fails only when ring is full, retries lost CAS races.
+	inline bool _internal_claim(size_t n,
+			const std::vector<const sequence *> &gating, int64_t &first) {
+		int64_t current = claimed.load(std::memory_order_relaxed);
+		for (;;) {
+			const int64_t next = current + (int64_t)n;
+			const int64_t wrap = next - (int64_t)SIZE;
+			// Acquire/release passes on what the producer which refreshed
+			// cache acquired from consumers, so reusing slot does not race
+			// with their last reads of it.
+			if (wrap > cached_gating.load(std::memory_order_acquire)) {
+				const int64_t m = minimum_sequence(gating, current);
+				if (wrap > m) {
+					return false;
+				}
+				cached_gating.store(m, std::memory_order_release);
+			}
+			if (claimed.compare_exchange_weak(current, next,
+						std::memory_order_relaxed,
+						std::memory_order_relaxed)) {
+				first = next - (int64_t)n + 1;
+				return true;
+			}
+		}
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> claimed = sequence::INITIAL;
+	alignas(64) std::atomic<int64_t> cached_gating = sequence::INITIAL;
+	alignas(64) std::atomic<int64_t> published[SIZE];
+};
+} // namespace detail
+
+//	Consumers and gating sequences are set up before first publish. Slots are
+//	default constructed once and reused, producers overwrite what they need.
+template<typename T, size_t SIZE, typename Producer = single_producer,
+		typename Wait = yielding_wait>
+class ring
+{
+public:
+	static_assert(std::has_single_bit(SIZE),
+			"size of broadcast::ring must be a power of 2");
+
+	static constexpr size_t MASK = SIZE - 1;
+
+	//	Consumer side view of ring, sees sequence once it is published and
+	//	processed by all dependencies.
+	class barrier
+	{
+	public:
+		//	Waits until seq is available, returns highest available sequence,
+		//	which may be greater, so caller can process whole batch at once.
+		inline int64_t wait_for(int64_t seq) {
+			return owner->wait.wait_for(seq, owner->sequencer.cursor(),
+					[this, seq]() { return available(seq); });
+		}
+
+		//	Highest available sequence, lower than seq when seq is not yet.
+		inline int64_t available(int64_t seq) const {
+			const int64_t a = detail::minimum_sequence(dependencies,
+					owner->sequencer.cursor().load(std::memory_order_acquire));
+			return owner->sequencer.highest_published(seq, a);
+		}
+
+		//	Waits for slots following the last processed by consumer, calls
+		//	f(T &value, int64_t seq, bool end_of_batch) for each available
+		//	one and releases them by advancing consumer. Returns number of
+		//	processed slots.
+		template<typename F>
+		inline size_t process(sequence &consumer, F &&f) {
+			const int64_t next = consumer.get() + 1;
+			return _internal_process(consumer, next, wait_for(next), f);
+		}
+
+		//	As process() but returns 0 instead of waiting.
+		template<typename F>
+		inline size_t try_process(sequence &consumer, F &&f) {
+			const int64_t next = consumer.get() + 1;
+			return _internal_process(consumer, next, available(next), f);
+		}
+
+	private:
+		friend class ring;
+
+		barrier(ring &owner, std::initializer_list<const sequence *> deps)
+			: owner(&owner), dependencies(deps) {}
+
+		template<typename F>
+		inline size_t _internal_process(sequence &consumer, int64_t next,
+				int64_t last, F &f) {
+			for (int64_t s = next; s <= last; ++s) {
+				f(owner->data[s & MASK], s, s == last);
+			}
+			if (last >= next) {
+				consumer.set(last);
+				return last - next + 1;
+			}
+			return 0;
+		}
+
+	private:
+		ring *owner;
+		std::vector<const sequence *> dependencies;
+	};
+
+	ring() = default;
+	ring(ring &&) = delete;
+	ring(const ring &) = delete;
+	ring &operator=(ring &&) = delete;
+	ring &operator=(const ring &) = delete;
+
+	//	Producers will not overwrite slots not yet released by s. Register
+	//	sequences of consumers no other consumer depends on. Without any
+	//	gating sequence producers never wait.
+	void add_gating_sequence(const sequence &s) {
+		gating.push_back(&s);
+	}
+
+	//	Barrier for consumer which has to run after all dependencies.
+	barrier new_barrier(std::initializer_list<const sequence *> dependencies = {}) {
+		return barrier(*this, dependencies);
+	}
+
+	//	Claims n <= SIZE consecutive slots and returns first sequence of
+	//	them, waits while ring is full. Every claimed sequence has to be
+	//	published, by single_producer in order of claiming.
+	inline int64_t claim(size_t n = 1) {
+		return sequencer.claim(n, gating);
+	}
+
+	//	As claim() but returns false instead of waiting.
+	inline bool try_claim(int64_t &first, size_t n = 1) {
+		return sequencer.try_claim(n, gating, first);
+	}
+
+	inline T &operator[](int64_t seq) {
+		return data[seq & MASK];
+	}
+	inline const T &operator[](int64_t seq) const {
+		return data[seq & MASK];
+	}
+
+	inline void publish(int64_t first, size_t n = 1) {
+		sequencer.publish(first, n);
+		wait.notify();
+	}
+
+	inline void push(const T &value) {
+		const int64_t seq = claim();
+		data[seq & MASK] = value;
+		publish(seq);
+	}
+
+	//	Highest claimed sequence.
+	inline int64_t cursor() const {
+		return sequencer.cursor().load(std::memory_order_acquire);
+	}
+
+private:
+	detail::sequencer<Producer, SIZE> sequencer;
+	[[no_unique_address]] Wait wait;
+	std::vector<const sequence *> gating;
+	T data[SIZE];
+};
+} // namespace broadcast
+}
+
+#endif
@@ -7,15 +7,28 @@
 #define CONCURRENT_THREADED_POLL_HPP
 
 #include <cstdint>
+#include <new>
 
 #include <atomic>
+#include <algorithm>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <utility>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 #include "node_stack.hpp"
+#include "time.hpp"
+#include "latency_histogram.hpp"
+#include "contention_stats.hpp"
 
 namespace nonconcurrent
 {
-template<size_t BYTES, size_t OBJECTS_PER_BUCKET>
+template<size_t BYTES, size_t OBJECTS_PER_BUCKET, typename Lock = std::mutex>
 class thread_local_pool;
 }
 
@@ -26,7 +39,9 @@ struct _byte_array : public concurrent::node<_byte_array<BYTES>>
 {
 };
 
-template<size_t BYTES>
+//	Lock guards global buckets (mutex) and list of thread local pools
+//	(mutex2), std::mutex or any of locks.hpp.
+template<size_t BYTES, typename Lock = std::mutex>
 class buckets_pool
 {
 public:
@@ -35,7 +50,8 @@ public:
 	using byte_array = _byte_array<BYTES>;
 	using node_stack = nonconcurrent::node_stack<byte_array>;
 	
-	buckets_pool(size_t max_buckets) : max_buckets(max_buckets) {
+	buckets_pool(size_t max_buckets) : max_buckets(max_buckets),
+		high_watermark(max_buckets), low_watermark(max_buckets) {
 		buckets = new std::atomic<byte_array*>[max_buckets];
 		sizes = new size_t[max_buckets];
 		for (int i=0; i<max_buckets; ++i) {
@@ -44,6 +60,7 @@ public:
 		}
 	}
 	~buckets_pool() {
+		stop_scavenger();
 		free_all();
 		delete[] buckets;
 		delete[] sizes;
@@ -54,9 +71,12 @@ public:
 	void release_bucket(node_stack &bucket, size_t count) {
 		bucket_releases_count++;
 		if (buckets_count.load() < max_buckets) {
-			std::lock_guard lock(mutex);
+			stat_lock_guard lock(mutex, contention);
 			if (buckets_count.load() < max_buckets) {
 				_internal_release_bucket(bucket, count);
+				if (buckets_count.load() > high_watermark) {
+					_internal_free_oldest_buckets(buckets_count.load() - low_watermark);
+				}
 				return;
 			}
 		}
@@ -69,20 +89,61 @@ public:
 		system_frees_count += c;
 	}
 	
-	byte_array *acquire_bucket(size_t *count) {
+	//	Returns global bucket, stolen bucket or, when both are unavailable,
+	//	wanted freshly allocated objects. Count of returned objects is stored
+	//	in count.
+	byte_array *acquire_bucket(size_t *count, size_t wanted = 1) {
+		if (buckets_count.load() > 0) {
+			stat_lock_guard lock(mutex, contention);
+			if (buckets_count.load() > 0) {
+				bucket_acquisitions_count++;
+				return _internal_acquire_bucket(count);
+			}
+		}
+		for (size_t i=0; i<steal_group_size; ++i) {
+			if (steal_group[i] != this) {
+				byte_array *ptr = steal_group[i]->try_acquire_bucket(count);
+				if (ptr != NULL) {
+					bucket_steals_count++;
+					steal_group[i]->objects_moved_out += *count;
+					objects_moved_in += *count;
+					return ptr;
+				}
+			}
+		}
+		if (wanted == 0) {
+			wanted = 1;
+		}
+		byte_array *first = NULL;
+		for (size_t i=0; i<wanted; ++i) {
+			byte_array *ptr = (byte_array *)malloc(BYTES);
+			ptr->__m_next = first;
+			first = ptr;
+		}
+		*count = wanted;
+		system_allocations_count += wanted;
+		sum_object_acquisition += wanted;
+		return first;
+	}
+	
+	//	Returns NULL when global pool is empty, never allocates.
+	byte_array *try_acquire_bucket(size_t *count) {
 		if (buckets_count.load() > 0) {
-			std::lock_guard lock(mutex);
+			stat_lock_guard lock(mutex, contention);
 			if (buckets_count.load() > 0) {
 				bucket_acquisitions_count++;
 				return _internal_acquire_bucket(count);
 			}
 		}
-		*count = 1;
-		byte_array *ptr = (byte_array *)malloc(BYTES);
-		++system_allocations_count;
-		++sum_object_acquisition;
-		ptr->__m_next = NULL;
-		return ptr;
+		return NULL;
+	}
+	
+	//	When this pool is empty, acquire_bucket() tries to take bucket from
+	//	pools in group (in order) before falling back to malloc. Group must
+	//	outlive this pool or be reset with set_steal_group(NULL, 0).
+	void set_steal_group(buckets_pool **group, size_t count) {
+		steal_group = group;
+		steal_group_size = count;
 	}
 	
 	uint64_t estimate_system_allocations() const {
@@ -101,9 +162,35 @@ public:
 		return bucket_releases_count.load();
 	}
 	
+	uint64_t count_bucket_steals() const {
+		return bucket_steals_count.load();
+	}
+	
+	uint64_t count_bucket_size_grows() const {
+		return bucket_size_grows_count.load();
+	}
+	
+	uint64_t count_bucket_size_shrinks() const {
+		return bucket_size_shrinks_count.load();
+	}
+	
+	//	Average number of objects in buckets released by thread local pools,
+	//	reflects bucket sizes chosen by them.
+	double average_released_bucket_size() const {
+		uint64_t releases = bucket_releases_count.load();
+		if (releases == 0) {
+			return 0.0;
+		}
+		return (double)sum_object_release.load() / (double)releases;
+	}
+	
+	//	Objects stolen by other pool in steal group are accounted to the
+	//	stealing pool, which may later free them.
 	uint64_t current_memory_resident_objects() const {
 		uint64_t frees = system_frees_count.load();
-		return system_allocations_count.load() - frees;
+		uint64_t moved_out = objects_moved_out.load();
+		return system_allocations_count.load() + objects_moved_in.load()
+			- frees - moved_out;
 	}
 	
 	uint64_t current_memory_resident() const {
@@ -123,8 +210,116 @@ public:
 		return BYTES;
 	}
 	
+	//	When after a release more than high buckets are held in global pool,
+	//	the oldest ones are freed until only low buckets remain.
+	//	Both values are clamped to max_buckets and low to high.
+	void set_watermarks(size_t high, size_t low) {
+		stat_lock_guard lock(mutex, contention);
+		high = std::min(high, max_buckets);
+		high_watermark.store(high, std::memory_order_relaxed);
+		low_watermark.store(std::min(low, high), std::memory_order_relaxed);
+		if (buckets_count.load() > high_watermark) {
+			_internal_free_oldest_buckets(buckets_count.load() - low_watermark);
+		}
+	}
+	
+	size_t get_high_watermark() const {
+		return high_watermark.load(std::memory_order_relaxed);
+	}
+	
+	size_t get_low_watermark() const {
+		return low_watermark.load(std::memory_order_relaxed);
+	}
+	
+	//	Frees least recently released buckets until at most target_bytes are
+	//	held in global pool. Returns number of bytes given back to system.
+	//	When release_to_system is true, also asks libc to return freed heap
+	//	pages to the OS (malloc_trim on glibc), which is the nearest
+	//	equivalent of madvise(MADV_DONTNEED) for malloc-backed objects.
+	uint64_t trim(uint64_t target_bytes, bool release_to_system = true) {
+		uint64_t freed = 0;
+		{
+			stat_lock_guard lock(mutex, contention);
+			size_t n = 0;
+			uint64_t held = objects_in_glob.load() * BYTES;
+			for (; n<buckets_count.load() && held > target_bytes; ++n) {
+				held -= sizes[n] * BYTES;
+			}
+			freed = _internal_free_oldest_buckets(n) * BYTES;
+		}
+		if (release_to_system) {
+			release_free_memory_to_system();
+		}
+		return freed;
+	}
+	
+	static void release_free_memory_to_system() {
+#if defined(__GLIBC__)
+		malloc_trim(0);
+#endif
+	}
+	
+	//	Starts background thread that every interval frees up to
+	//	max_buckets_per_tick buckets which were not used since previous tick.
+	//	Buckets are never scavenged below low watermark.
+	void start_scavenger(time::diff interval, size_t max_buckets_per_tick,
+			bool release_to_system = true) {
+		std::lock_guard lock(scavenger_mutex);
+		if (scavenger.joinable()) {
+			return;
+		}
+		scavenger_running = true;
+		{
+			stat_lock_guard lock2(mutex, contention);
+			min_buckets_since_scavenge = buckets_count.load();
+		}
+		scavenger = std::thread([=, this](){
+			_internal_scavenger_loop(interval, max_buckets_per_tick,
+					release_to_system);
+		});
+	}
+	
+	void stop_scavenger() {
+		std::lock_guard lock(scavenger_mutex);
+		if (scavenger.joinable() == false) {
+			return;
+		}
+		{
+			std::lock_guard lock2(scavenger_sleep_mutex);
+			scavenger_running = false;
+		}
+		scavenger_cv.notify_all();
+		scavenger.join();
+	}
+	
+	//	Performs single scavenger step, returns number of freed buckets.
+	size_t scavenge(size_t max_buckets_to_free) {
+		stat_lock_guard lock(mutex, contention);
+		size_t count = buckets_count.load();
+		size_t idle = std::min(min_buckets_since_scavenge, count);
+		if (count > low_watermark) {
+			idle = std::min(idle, count - low_watermark);
+		} else {
+			idle = 0;
+		}
+		idle = std::min(idle, max_buckets_to_free);
+		_internal_free_oldest_buckets(idle);
+		min_buckets_since_scavenge = buckets_count.load();
+		return idle;
+	}
+	
+	uint64_t count_trimmed_buckets() const {
+		return trimmed_buckets_count.load();
+	}
+	
+	//	Wait and hold times of global mutex, all zero unless compiled with
+	//	CONCURRENT_CONTENTION_STATS.
+	contention_snapshot get_contention_stats() const {
+		return contention.snapshot();
+	}
+	
 	void free_all() {
-		std::lock_guard lock(mutex);
+		stat_lock_guard lock(mutex, contention);
 		for (int i=0; i<max_buckets; ++i) {
 			node_stack b;
 			if (buckets[i] != NULL) {
@@ -140,17 +335,17 @@ public:
 		}
 	}
 	
-	std::mutex mutex2;
+	Lock mutex2;
 	template<size_t S>
-	nonconcurrent::node_stack<nonconcurrent::thread_local_pool<BYTES, S>> &mod_tls_pool(nonconcurrent::thread_local_pool<BYTES, S> *tls_pool, bool adding) {
-		static nonconcurrent::node_stack<nonconcurrent::thread_local_pool<BYTES, S>> stack;
+	nonconcurrent::node_stack<nonconcurrent::thread_local_pool<BYTES, S, Lock>> &mod_tls_pool(nonconcurrent::thread_local_pool<BYTES, S, Lock> *tls_pool, bool adding) {
+		static nonconcurrent::node_stack<nonconcurrent::thread_local_pool<BYTES, S, Lock>> stack;
 		std::lock_guard lock(mutex2);
 		if (tls_pool != NULL) {
 			if (adding) {
 				tls_pool->__m_next = NULL;
 				stack.push(tls_pool);
 			} else {
-				nonconcurrent::node_stack<nonconcurrent::thread_local_pool<BYTES, S>> tmp;
+				nonconcurrent::node_stack<nonconcurrent::thread_local_pool<BYTES, S, Lock>> tmp;
 				while (!stack.empty()) {
 					auto p = stack.pop();
 					if (p == tls_pool) {
@@ -169,6 +364,56 @@ public:
 	}
 	
 private:
+	//	Requires locked mutex. Returns number of freed objects.
+	size_t _internal_free_oldest_buckets(size_t n) {
+		size_t count = buckets_count.load();
+		n = std::min(n, count);
+		if (n == 0) {
+			return 0;
+		}
+		size_t objects = 0;
+		for (size_t i=0; i<n; ++i) {
+			node_stack b;
+			if (buckets[i] != NULL) {
+				b.push_all(buckets[i]);
+			}
+			objects += sizes[i];
+			while (!b.empty()) {
+				free(b.pop());
+			}
+		}
+		for (size_t i=n; i<count; ++i) {
+			buckets[i-n] = buckets[i].load();
+			sizes[i-n] = sizes[i];
+		}
+		for (size_t i=count-n; i<count; ++i) {
+			buckets[i] = NULL;
+			sizes[i] = 0;
+		}
+		buckets_count -= n;
+		if (min_buckets_since_scavenge > buckets_count.load()) {
+			min_buckets_since_scavenge = buckets_count.load();
+		}
+		objects_in_glob -= objects;
+		system_frees_count += objects;
+		trimmed_buckets_count += n;
+		return objects;
+	}
+	
+	void _internal_scavenger_loop(time::diff interval, size_t max_per_tick,
+			bool release_to_system) {
+		std::unique_lock lock(scavenger_sleep_mutex);
+		while (scavenger_running) {
+			scavenger_cv.wait_for(lock, std::chrono::nanoseconds(interval.ns));
+			if (scavenger_running == false) {
+				break;
+			}
+			if (scavenge(max_per_tick) > 0 && release_to_system) {
+				release_free_memory_to_system();
+			}
+		}
+	}
+	
 	void _internal_release_bucket(node_stack &bucket, size_t count) {
 		size_t id = buckets_count.load();
 		buckets[id] = bucket.pop_all();
@@ -184,24 +429,48 @@ private:
 		sizes[buckets_count] = 0;
 		byte_array *ret = buckets[buckets_count];
 		buckets[buckets_count] = NULL;
+		if (min_buckets_since_scavenge > buckets_count.load()) {
+			min_buckets_since_scavenge = buckets_count.load();
+		}
 		objects_in_glob -= *count;
 		sum_object_acquisition += *count;
 		return ret;
 	}
 	
 private:
-	std::mutex mutex;
+	Lock mutex;
+	[[no_unique_address]] contention_counters contention;
 	const size_t max_buckets;
 	std::atomic<byte_array*> *buckets;
 	size_t *sizes;
 	std::atomic<size_t> buckets_count = 0;
 	
+	buckets_pool **steal_group = NULL;
+	size_t steal_group_size = 0;
+	
+	// Written under mutex, atomic only for lock-free getters.
+	std::atomic<size_t> high_watermark;
+	std::atomic<size_t> low_watermark;
+	size_t min_buckets_since_scavenge = 0;
+	
+	std::mutex scavenger_mutex;
+	std::mutex scavenger_sleep_mutex;
+	std::condition_variable scavenger_cv;
+	std::thread scavenger;
+	bool scavenger_running = false;
+	
 public:
 	std::atomic<uint64_t> system_allocations_count = 0;
 	std::atomic<uint64_t> system_frees_count = 0;
 	std::atomic<uint64_t> bucket_acquisitions_count = 0;
 	std::atomic<uint64_t> bucket_releases_count = 0;
+	std::atomic<uint64_t> bucket_steals_count = 0;
+	std::atomic<uint64_t> objects_moved_in = 0;
+	std::atomic<uint64_t> objects_moved_out = 0;
+	std::atomic<uint64_t> bucket_size_grows_count = 0;
+	std::atomic<uint64_t> bucket_size_shrinks_count = 0;
 	std::atomic<uint64_t> objects_in_glob = 0;
+	std::atomic<uint64_t> trimmed_buckets_count = 0;
 	
 	std::atomic<uint64_t> local_sum_acquisition = 0;
 	std::atomic<uint64_t> local_sum_release = 0;
@@ -213,12 +482,12 @@ public:
 
 namespace nonconcurrent
 {
-template<size_t BYTES, size_t OBJECTS_PER_BUCKET>
-class thread_local_pool : public concurrent::node<thread_local_pool<BYTES, OBJECTS_PER_BUCKET>>
+template<size_t BYTES, size_t OBJECTS_PER_BUCKET, typename Lock>
+class thread_local_pool : public concurrent::node<thread_local_pool<BYTES, OBJECTS_PER_BUCKET, Lock>>
 {
 public:
 	
-	thread_local_pool(concurrent::buckets_pool<BYTES> *buckets_pool) {
+	thread_local_pool(concurrent::buckets_pool<BYTES, Lock> *buckets_pool) {
 		this->buckets_pool = buckets_pool;
 		buckets_pool->mod_tls_pool(this, true);
 	}
@@ -227,7 +496,12 @@ public:
 		release_buckets_to_global();
 	}
 	
+	concurrent::buckets_pool<BYTES, Lock> *get_buckets_pool() {
+		return buckets_pool;
+	}
+	
 	void release_buckets_to_global() {
+		_internal_flush_local_stats();
 		for (int i=0; i<2; ++i) {
 			_internal_swap();
 			if (size[1] > 0) {
@@ -238,12 +512,19 @@ public:
 	
 	using byte_array = concurrent::_byte_array<BYTES>;
 	
+	//	Effective bucket size adapts at runtime between these bounds.
+	static constexpr size_t MIN_OBJECTS_PER_BUCKET =
+		OBJECTS_PER_BUCKET < 8 ? OBJECTS_PER_BUCKET : 8;
+	static constexpr size_t MAX_OBJECTS_PER_BUCKET = OBJECTS_PER_BUCKET;
+	
 	template<typename T, typename... Args>
-	T *acquire(Args... args) {
+	T *acquire(Args&&... args) {
 		static_assert(sizeof(T) <= BYTES);
-		buckets_pool->local_sum_acquisition++;
+		local_acquisitions++;
+		ops_since_global_trip++;
 		if (size[0] == 0) {
 			if (size[1] == 0) {
+				_internal_adapt_bucket_size(TRIP_REFILL);
 				_internal_acquire_one_bucket();
 			} else {
 				_internal_swap();
@@ -251,26 +532,85 @@ public:
 		}
 		size[0]--;
 		byte_array *ptr = buckets[0].pop();
-		return new(ptr) T(std::move(args)...);
+		return new(ptr) T(std::forward<Args>(args)...);
 	}
 	
 	template<typename T>
 	void release(T *ptr) {
-		buckets_pool->local_sum_release++;
+		local_releases++;
+		ops_since_global_trip++;
 		ptr->~T();
-		if (size[1] >= OBJECTS_PER_BUCKET) {
-			if (size[0] >= OBJECTS_PER_BUCKET) {
+		if (size[1] >= bucket_size) {
+			if (size[0] >= bucket_size) {
+				_internal_adapt_bucket_size(TRIP_FLUSH);
 				_internal_release_one_bucket();
 			} else {
 				_internal_swap();
 			}
 		}
 		size[1]++;
-		ptr->__m_next = NULL;
 		buckets[1].push((byte_array*)ptr);
 	}
 	
+	size_t current_bucket_size() const {
+		return bucket_size;
+	}
+	
+	uint64_t count_global_refills() const {
+		return global_refills_count;
+	}
+	
+	uint64_t count_global_flushes() const {
+		return global_flushes_count;
+	}
+	
+	size_t count_local_objects() const {
+		return size[0] + size[1];
+	}
+	
 private:
+	enum global_trip {
+		TRIP_NONE,
+		TRIP_REFILL,
+		TRIP_FLUSH,
+	};
+	
+	//	Consecutive trips to global pool in the same direction within short
+	//	span of local operations mean a burst, so bucket grows. Long runs
+	//	served locally mean bucket may shrink to hoard less objects.
+	void _internal_adapt_bucket_size(global_trip trip) {
+		_internal_flush_local_stats();
+		if (trip == TRIP_REFILL) {
+			global_refills_count++;
+		} else {
+			global_flushes_count++;
+		}
+		if (trip == last_trip && ops_since_global_trip <= bucket_size * 2) {
+			if (bucket_size < MAX_OBJECTS_PER_BUCKET) {
+				bucket_size = std::min(bucket_size * 2, MAX_OBJECTS_PER_BUCKET);
+				buckets_pool->bucket_size_grows_count++;
+			}
+		} else if (ops_since_global_trip > bucket_size * 16) {
+			if (bucket_size > MIN_OBJECTS_PER_BUCKET) {
+				bucket_size = std::max(bucket_size / 2, MIN_OBJECTS_PER_BUCKET);
+				buckets_pool->bucket_size_shrinks_count++;
+			}
+		}
+		last_trip = trip;
+		ops_since_global_trip = 0;
+	}
+	
+	void _internal_flush_local_stats() {
+		if (local_acquisitions) {
+			buckets_pool->local_sum_acquisition += local_acquisitions;
+			local_acquisitions = 0;
+		}
+		if (local_releases) {
+			buckets_pool->local_sum_release += local_releases;
+			local_releases = 0;
+		}
+	}
+	
 	void _internal_swap() {
 		std::swap(size[0], size[1]);
 		std::swap(buckets[0], buckets[1]);
@@ -282,14 +622,41 @@ private:
 	}
 	
 	void _internal_acquire_one_bucket() {
-		buckets[0].push_all(buckets_pool->acquire_bucket(&(size[0])));
+		concurrent::latency_histogram *hist =
+			concurrent::latency_hooks::pool_refill.load(std::memory_order_relaxed);
+		if (hist == NULL) {
+			_internal_fill_bucket();
+			return;
+		}
+		const concurrent::time::point start = concurrent::time::now_fast();
+		_internal_fill_bucket();
+		hist->record_since(start);
+	}
+	
+	//	Buckets in global pool have size of releasing thread, so collect them
+	//	until current bucket_size is reached, rest is allocated at once.
+	void _internal_fill_bucket() {
+		while (size[0] < bucket_size) {
+			size_t count = 0;
+			buckets[0].push_all(buckets_pool->acquire_bucket(&count,
+						bucket_size - size[0]));
+			size[0] += count;
+		}
 	}
 	
 private:
 	node_stack<byte_array> buckets[2];
 	size_t size[2] = {0, 0};
 	
-	concurrent::buckets_pool<BYTES> *buckets_pool;
+	size_t bucket_size = MIN_OBJECTS_PER_BUCKET;
+	size_t ops_since_global_trip = 0;
+	global_trip last_trip = TRIP_NONE;
+	uint64_t global_refills_count = 0;
+	uint64_t global_flushes_count = 0;
+	uint64_t local_acquisitions = 0;
+	uint64_t local_releases = 0;
+	
+	concurrent::buckets_pool<BYTES, Lock> *buckets_pool;
 };
 }
 
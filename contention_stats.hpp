@@ -0,0 +1,149 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_CONTENTION_STATS_HPP
+#define CONCURRENT_CONTENTION_STATS_HPP
+
+#include <cstdint>
+
+#include <atomic>
+
+#include "time.hpp"
+
+//	Define CONCURRENT_CONTENTION_STATS=1 (cmake option of the same name) to
+//	count CAS retries and mutex wait/hold times per instance of lock-free
+//	structures and pools. When disabled counters are empty classes stored
+//	with [[no_unique_address]] and all calls compile to nothing.
+#ifndef CONCURRENT_CONTENTION_STATS
+#define CONCURRENT_CONTENTION_STATS 0
+#endif
+
+namespace concurrent
+{
+struct contention_snapshot {
+	uint64_t cas_failures = 0;
+	uint64_t lock_acquisitions = 0;
+	//	Acquisitions which found mutex already locked.
+	uint64_t lock_contended = 0;
+	time::diff lock_wait;
+	time::diff lock_hold;
+};
+
+#if CONCURRENT_CONTENTION_STATS
+
+class contention_counters
+{
+public:
+	inline void add_cas_failure() {
+		cas_failures.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void add_lock(bool contended, time::diff wait, time::diff hold) {
+		lock_acquisitions.fetch_add(1, std::memory_order_relaxed);
+		if (contended) {
+			lock_contended.fetch_add(1, std::memory_order_relaxed);
+			lock_wait_ns.fetch_add(wait.ns, std::memory_order_relaxed);
+		}
+		lock_hold_ns.fetch_add(hold.ns, std::memory_order_relaxed);
+	}
+
+	contention_snapshot snapshot() const {
+		return {cas_failures.load(std::memory_order_relaxed),
+				lock_acquisitions.load(std::memory_order_relaxed),
+				lock_contended.load(std::memory_order_relaxed),
+				{lock_wait_ns.load(std::memory_order_relaxed)},
+				{lock_hold_ns.load(std::memory_order_relaxed)}};
+	}
+
+	void reset() {
+		cas_failures.store(0, std::memory_order_relaxed);
+		lock_acquisitions.store(0, std::memory_order_relaxed);
+		lock_contended.store(0, std::memory_order_relaxed);
+		lock_wait_ns.store(0, std::memory_order_relaxed);
+		lock_hold_ns.store(0, std::memory_order_relaxed);
+	}
+
+	static constexpr bool enabled = true;
+
+private:
+	std::atomic<uint64_t> cas_failures = 0;
+	std::atomic<uint64_t> lock_acquisitions = 0;
+	std::atomic<uint64_t> lock_contended = 0;
+	std::atomic<int64_t> lock_wait_ns = 0;
+	std::atomic<int64_t> lock_hold_ns = 0;
+};
+
+//	lock_guard which measures time spent waiting for and holding mutex. Wait
+//	is timed only when try_lock() fails, so uncontended acquisition costs one
+//	extra timestamp for hold time.
+template<typename M>
+class stat_lock_guard
+{
+public:
+	stat_lock_guard(M &mutex, contention_counters &counters)
+		: mutex(mutex), counters(counters) {
+		if (mutex.try_lock()) {
+			acquired = time::now_fast();
+			return;
+		}
+		const time::point start = time::now_fast();
+		mutex.lock();
+		acquired = time::now_fast();
+		wait = acquired - start;
+		contended = true;
+	}
+
+	~stat_lock_guard() {
+		const time::diff hold = time::now_fast() - acquired;
+		mutex.unlock();
+		counters.add_lock(contended, wait, hold);
+	}
+
+	stat_lock_guard(const stat_lock_guard &) = delete;
+	stat_lock_guard &operator=(const stat_lock_guard &) = delete;
+
+private:
+	M &mutex;
+	contention_counters &counters;
+	time::point acquired;
+	time::diff wait;
+	bool contended = false;
+};
+
+#else
+
+class contention_counters
+{
+public:
+	inline void add_cas_failure() {}
+	inline void add_lock(bool, time::diff, time::diff) {}
+	contention_snapshot snapshot() const { return {}; }
+	void reset() {}
+
+	static constexpr bool enabled = false;
+};
+
+template<typename M>
+class stat_lock_guard
+{
+public:
+	stat_lock_guard(M &mutex, contention_counters &) : mutex(mutex) {
+		mutex.lock();
+	}
+	~stat_lock_guard() {
+		mutex.unlock();
+	}
+
+	stat_lock_guard(const stat_lock_guard &) = delete;
+	stat_lock_guard &operator=(const stat_lock_guard &) = delete;
+
+private:
+	M &mutex;
+};
+
+#endif
+}
+
+#endif
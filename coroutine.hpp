@@ -0,0 +1,226 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_COROUTINE_HPP
+#define CONCURRENT_COROUTINE_HPP
+
+#include <atomic>
+#include <utility>
+#include <coroutine>
+
+#include "future.hpp"
+#include "object_pool.hpp"
+
+namespace concurrent
+{
+//	Coroutine frames up to 1024 bytes are allocated from thread_cached_pool
+//	size classes, larger ones with operator new.
+inline void *allocate_coroutine_frame(size_t size) {
+	if (size <= 64) {
+		return thread_cached_pool<64>::allocate();
+	} else if (size <= 128) {
+		return thread_cached_pool<128>::allocate();
+	} else if (size <= 256) {
+		return thread_cached_pool<256>::allocate();
+	} else if (size <= 512) {
+		return thread_cached_pool<512>::allocate();
+	} else if (size <= 1024) {
+		return thread_cached_pool<1024>::allocate();
+	}
+	return ::operator new(size);
+}
+
+inline void deallocate_coroutine_frame(void *ptr, size_t size) {
+	if (size <= 64) {
+		thread_cached_pool<64>::deallocate(ptr);
+	} else if (size <= 128) {
+		thread_cached_pool<128>::deallocate(ptr);
+	} else if (size <= 256) {
+		thread_cached_pool<256>::deallocate(ptr);
+	} else if (size <= 512) {
+		thread_cached_pool<512>::deallocate(ptr);
+	} else if (size <= 1024) {
+		thread_cached_pool<1024>::deallocate(ptr);
+	} else {
+		::operator delete(ptr);
+	}
+}
+
+//	Suspends coroutine until future is finished and resumes it on thread
+//	finishing promise, or through executor.execute() when given. Never
+//	blocks a thread. Result is copied out, awaiter is a temporary and its
+//	future does not outlive co_await expression. Future finished with error
+//	gives default constructed T, check future::is_valid() when it matters.
+template<typename T, typename E = void>
+class future_awaiter {
+public:
+	future_awaiter(future<T> fut, E *executor = NULL)
+		: fut(std::move(fut)), executor(executor) {}
+	
+	bool await_ready() const {
+		return fut.finished() || fut.has_any_state() == false;
+	}
+	
+	//	Whichever of this function and continuation comes second resumes,
+	//	so continuation running inline does not nest resumption.
+	bool await_suspend(std::coroutine_handle<> h) {
+		fut.on_finish([this, h](future<T> &) {
+					if (resumed.exchange(true, std::memory_order_acq_rel)) {
+						_internal_resume(h);
+					}
+				});
+		return resumed.exchange(true, std::memory_order_acq_rel) == false;
+	}
+	
+	T await_resume() {
+		return fut.get();
+	}
+	
+private:
+	void _internal_resume(std::coroutine_handle<> h) {
+		if constexpr (std::is_void_v<E>) {
+			h.resume();
+		} else {
+			executor->execute([h]() { h.resume(); });
+		}
+	}
+	
+protected:
+	future<T> fut;
+	
+private:
+	E *executor;
+	std::atomic<bool> resumed = false;
+};
+
+template<typename T>
+inline future_awaiter<T> operator co_await(future<T> &fut) {
+	return future_awaiter<T>(fut);
+}
+
+template<typename T>
+inline future_awaiter<T> operator co_await(future<T> &&fut) {
+	return future_awaiter<T>(std::move(fut));
+}
+
+//	co_await resume_on(fut, executor) resumes through executor.execute().
+template<typename T, typename E>
+inline future_awaiter<T, E> resume_on(future<T> fut, E &executor) {
+	return future_awaiter<T, E>(std::move(fut), &executor);
+}
+
+//	co_await schedule_on(executor) continues coroutine inside executor.
+template<typename E>
+class schedule_awaiter {
+public:
+	schedule_awaiter(E &executor) : executor(executor) {}
+	
+	bool await_ready() const { return false; }
+	void await_suspend(std::coroutine_handle<> h) {
+		executor.execute([h]() { h.resume(); });
+	}
+	void await_resume() {}
+	
+private:
+	E &executor;
+};
+
+template<typename E>
+inline schedule_awaiter<E> schedule_on(E &executor) {
+	return schedule_awaiter<E>(executor);
+}
+
+//	Eagerly started coroutine, result is delivered through future<T>, so
+//	task can be co_awaited, waited on or composed with then()/when_all().
+//	Frame destroys itself when coroutine finishes. Exception leaving
+//	coroutine finishes future with error, then get() and co_await give
+//	default constructed T and is_valid() returns false.
+template<typename T>
+class task {
+public:
+	class promise_type {
+	public:
+		task get_return_object() { return task(p.get_future()); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_value(T v) { p.set_value(std::move(v)); }
+		void unhandled_exception() { p.set_error(); }
+		
+		static void *operator new(size_t size) {
+			return allocate_coroutine_frame(size);
+		}
+		static void operator delete(void *ptr, size_t size) {
+			deallocate_coroutine_frame(ptr, size);
+		}
+		
+	private:
+		promise<T> p;
+	};
+	
+	task() = default;
+	
+	future<T> &get_future() { return fut; }
+	T &get() { return fut.get(); }
+	bool finished() const { return fut.finished(); }
+	bool is_valid() const { return fut.is_valid(); }
+	
+	future_awaiter<T> operator co_await() { return future_awaiter<T>(fut); }
+	
+private:
+	task(future<T> &&fut) : fut(std::move(fut)) {}
+	
+	future<T> fut;
+};
+
+template<>
+class task<void> {
+public:
+	class promise_type {
+	public:
+		task get_return_object() { return task(p.get_future()); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { p.set_value(true); }
+		void unhandled_exception() { p.set_error(); }
+		
+		static void *operator new(size_t size) {
+			return allocate_coroutine_frame(size);
+		}
+		static void operator delete(void *ptr, size_t size) {
+			deallocate_coroutine_frame(ptr, size);
+		}
+		
+	private:
+		promise<bool> p;
+	};
+	
+	task() = default;
+	
+	//	Finished with true unless coroutine exited with exception, which
+	//	leaves future in error state. get() and co_await report the same,
+	//	true on success and false when coroutine exited with exception.
+	future<bool> &get_future() { return fut; }
+	bool get() {
+		fut.wait();
+		return fut.is_valid();
+	}
+	bool finished() const { return fut.finished(); }
+	
+	class awaiter : public future_awaiter<bool> {
+	public:
+		using future_awaiter<bool>::future_awaiter;
+		bool await_resume() { return fut.is_valid(); }
+	};
+	
+	awaiter operator co_await() { return awaiter(fut); }
+	
+private:
+	task(future<bool> &&fut) : fut(std::move(fut)) {}
+	
+	future<bool> fut;
+};
+}
+
+#endif
@@ -0,0 +1,198 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_EXECUTOR_CPP
+#define CONCURRENT_EXECUTOR_CPP
+
+#include <climits>
+
+#include <thread>
+
+#include "futex.hpp"
+#include "executor.hpp"
+
+namespace concurrent
+{
+struct executor::worker {
+	spmc::deque<work_item> deque;
+	std::thread thread;
+	executor *owner = NULL;
+	size_t index = 0;
+	uint64_t rng = 0;
+};
+
+namespace
+{
+thread_local executor *tls_executor = NULL;
+thread_local size_t tls_worker_index = (size_t)-1;
+
+// Spins before parking, so short gaps between tasks avoid futex syscalls.
+constexpr int SPIN_ROUNDS = 64;
+
+inline uint64_t next_random(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+} // namespace
+
+executor::executor(size_t threads)
+{
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads == 0) {
+		threads = 1;
+	}
+	workers_count = threads;
+	workers = new worker[workers_count];
+	for (size_t i = 0; i < workers_count; ++i) {
+		workers[i].owner = this;
+		workers[i].index = i;
+		workers[i].rng = 0x9E3779B97F4A7C15ull * (i + 1);
+	}
+	for (size_t i = 0; i < workers_count; ++i) {
+		worker *w = &workers[i];
+		w->thread = std::thread([this, w]() { _internal_worker_loop(w); });
+	}
+}
+
+executor::~executor()
+{
+	stopping.store(true);
+	wake_epoch.fetch_add(1);
+	futex::wake_all(&wake_epoch);
+	for (size_t i = 0; i < workers_count; ++i) {
+		workers[i].thread.join();
+	}
+	delete[] workers;
+	workers = NULL;
+}
+
+executor *executor::current() { return tls_executor; }
+
+size_t executor::current_worker_index() { return tls_worker_index; }
+
+void executor::_internal_submit(work_item *item)
+{
+	if (tls_executor == this) {
+		workers[tls_worker_index].deque.push(item);
+	} else {
+		injection.push(item);
+	}
+	_internal_notify();
+}
+
+// Pairs with sleepers increment and recheck of queues in worker loop.
+void executor::_internal_notify()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers.load(std::memory_order_relaxed) > 0) {
+		wake_epoch.fetch_add(1);
+		futex::wake_one(&wake_epoch);
+	}
+}
+
+void executor::_internal_worker_loop(worker *self)
+{
+	tls_executor = this;
+	tls_worker_index = self->index;
+	for (;;) {
+		work_item *item = NULL;
+		for (int i = 0; i < SPIN_ROUNDS && item == NULL; ++i) {
+			item = _internal_find_work(self);
+			if (item == NULL && i >= SPIN_ROUNDS / 2) {
+				std::this_thread::yield();
+			}
+		}
+		if (item != NULL) {
+			item->run();
+			continue;
+		}
+		if (stopping.load()) {
+			break;
+		}
+		sleepers.fetch_add(1);
+		uint32_t epoch = wake_epoch.load();
+		// Queue emptiness checks are relaxed, this fence pairs with the one
+		// in _internal_notify().
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_internal_has_visible_work() == false && stopping.load() == false) {
+			parks_count.fetch_add(1, std::memory_order_relaxed);
+			futex::wait(&wake_epoch, epoch);
+		}
+		sleepers.fetch_sub(1);
+	}
+	tls_executor = NULL;
+	tls_worker_index = (size_t)-1;
+}
+
+work_item *executor::_internal_find_work(worker *self)
+{
+	work_item *item = self->deque.pop();
+	if (item != NULL) {
+		return item;
+	}
+	item = _internal_take_injected(self);
+	if (item != NULL) {
+		return item;
+	}
+	if (workers_count > 1) {
+		size_t start = next_random(self->rng) % workers_count;
+		for (size_t i = 0; i < workers_count; ++i) {
+			worker *victim = &workers[(start + i) % workers_count];
+			if (victim == self) {
+				continue;
+			}
+			item = victim->deque.steal();
+			if (item != NULL) {
+				steals_count.fetch_add(1, std::memory_order_relaxed);
+				return item;
+			}
+		}
+	}
+	return NULL;
+}
+
+// Only one worker at a time drains injection queue into its own deque, from
+// where others may steal.
+work_item *executor::_internal_take_injected(worker *self)
+{
+	if (injection.get_input_stack().empty() ||
+		injection_lock.test_and_set(std::memory_order_acquire)) {
+		return NULL;
+	}
+	work_item *first = injection.pop();
+	if (first != NULL) {
+		size_t moved = 0;
+		while (work_item *item = injection.pop()) {
+			self->deque.push(item);
+			++moved;
+		}
+		if (moved > 0) {
+			_internal_notify();
+		}
+	}
+	injection_lock.clear(std::memory_order_release);
+	return first;
+}
+
+bool executor::_internal_has_visible_work()
+{
+	if (injection.get_input_stack().empty() == false) {
+		return true;
+	}
+	for (size_t i = 0; i < workers_count; ++i) {
+		if (workers[i].deque.empty() == false) {
+			return true;
+		}
+	}
+	return false;
+}
+} // namespace concurrent
+
+#endif
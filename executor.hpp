@@ -0,0 +1,121 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_EXECUTOR_HPP
+#define CONCURRENT_EXECUTOR_HPP
+
+#include <cstdint>
+
+#include <atomic>
+#include <utility>
+#include <type_traits>
+
+#include "mpsc_queue.hpp"
+#include "spmc_deque.hpp"
+#include "future.hpp"
+#include "work_item.hpp"
+
+namespace concurrent
+{
+//	Result type of future returned by executor::submit(), functions
+//	returning void give future<bool> finished with true.
+template<typename F>
+using submit_result_t = std::conditional_t<
+	std::is_void_v<std::invoke_result_t<std::decay_t<F> &>>, bool,
+	std::invoke_result_t<std::decay_t<F> &>>;
+
+//	Work stealing thread pool. Every worker owns spmc::deque, tasks
+//	submitted from worker go to its deque, tasks from other threads go to
+//	injection mpsc::queue, which idle workers move into their deques. Idle
+//	workers steal from random victims and then park on futex. Task nodes
+//	are allocated from object_pool. Requires linking executor.cpp.
+//
+//	Blocking on future inside task blocks whole worker, use then() or
+//	coroutines instead.
+class executor
+{
+public:
+	//	0 threads means std::thread::hardware_concurrency().
+	executor(size_t threads = 0);
+	//	Runs all already submitted tasks, then joins workers.
+	~executor();
+	
+	executor(const executor &) = delete;
+	executor(executor &&) = delete;
+	executor &operator=(const executor &) = delete;
+	executor &operator=(executor &&) = delete;
+	
+	//	func must not throw, exception escaping it terminates the process.
+	//	Use submit() for functions which may throw.
+	template<typename F>
+	void execute(F &&func) {
+		_internal_submit(work_item::create(std::forward<F>(func)));
+	}
+	
+	//	Exception thrown by func finishes returned future with error.
+	template<typename F>
+	future<submit_result_t<F>> submit(F &&func) {
+		using R = submit_result_t<F>;
+		promise<R> p;
+		future<R> ret = p.get_future();
+		execute([p = std::move(p), func = std::forward<F>(func)]() mutable {
+					try {
+						if constexpr (std::is_void_v<std::invoke_result_t<decltype(func) &>>) {
+							func();
+							p.set_value(true);
+						} else {
+							p.set_value(func());
+						}
+					} catch (...) {
+						p.set_error();
+					}
+				});
+		return ret;
+	}
+	
+	size_t count_workers() const {
+		return workers_count;
+	}
+	
+	//	Executor of calling worker thread, NULL outside of workers.
+	static executor *current();
+	//	Index of calling worker thread in its executor, or (size_t)-1.
+	static size_t current_worker_index();
+	
+	uint64_t count_steals() const {
+		return steals_count.load(std::memory_order_relaxed);
+	}
+	
+	uint64_t count_parks() const {
+		return parks_count.load(std::memory_order_relaxed);
+	}
+	
+private:
+	struct worker;
+	
+	void _internal_submit(work_item *item);
+	void _internal_notify();
+	void _internal_worker_loop(worker *self);
+	work_item *_internal_find_work(worker *self);
+	work_item *_internal_take_injected(worker *self);
+	bool _internal_has_visible_work();
+	
+private:
+	worker *workers;
+	size_t workers_count;
+	
+	mpsc::queue<work_item> injection;
+	std::atomic_flag injection_lock;
+	
+	alignas(64) std::atomic<uint32_t> wake_epoch = 0;
+	std::atomic<uint32_t> sleepers = 0;
+	std::atomic<bool> stopping = false;
+	
+	std::atomic<uint64_t> steals_count = 0;
+	std::atomic<uint64_t> parks_count = 0;
+};
+}
+
+#endif
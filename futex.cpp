@@ -0,0 +1,123 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_FUTEX_CPP
+#define CONCURRENT_FUTEX_CPP
+
+#if defined(__linux__) && !defined(CONCURRENT_FUTEX_USE_CONDITION_VARIABLE)
+#define CONCURRENT_FUTEX_LINUX
+#endif
+
+#include <climits>
+
+#if defined(CONCURRENT_FUTEX_LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#else
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#include "futex.hpp"
+
+namespace concurrent
+{
+namespace futex
+{
+#if defined(CONCURRENT_FUTEX_LINUX)
+// time::now() is based on steady_clock, which is CLOCK_MONOTONIC on linux,
+// so deadline is passed as absolute timeout of FUTEX_WAIT_BITSET.
+void wait(std::atomic<uint32_t> *addr, uint32_t expected)
+{
+	syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT_PRIVATE, expected, NULL,
+			NULL, 0);
+}
+
+bool wait_until(std::atomic<uint32_t> *addr, uint32_t expected,
+				time::point deadline)
+{
+	if (time::now() >= deadline) {
+		return false;
+	}
+	struct timespec ts;
+	ts.tv_sec = deadline.ns / 1000000000ll;
+	ts.tv_nsec = deadline.ns % 1000000000ll;
+	syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT_BITSET_PRIVATE, expected,
+			&ts, NULL, FUTEX_BITSET_MATCH_ANY);
+	return true;
+}
+
+void wake_one(std::atomic<uint32_t> *addr)
+{
+	syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+void wake_all(std::atomic<uint32_t> *addr)
+{
+	syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+			NULL, 0);
+}
+#else
+namespace
+{
+// Addresses are hashed into fixed table of condition variables, so wakes
+// notify all waiters of a stripe and waiters recheck their value.
+struct stripe {
+	std::mutex mutex;
+	std::condition_variable cv;
+};
+
+stripe &get_stripe(const void *addr)
+{
+	static stripe stripes[64];
+	uintptr_t h = (uintptr_t)addr;
+	h ^= h >> 17;
+	h *= 0x9E3779B97F4A7C15ull;
+	return stripes[(h >> 58) & 63];
+}
+} // namespace
+
+void wait(std::atomic<uint32_t> *addr, uint32_t expected)
+{
+	stripe &s = get_stripe(addr);
+	std::unique_lock lock(s.mutex);
+	if (addr->load() == expected) {
+		s.cv.wait(lock);
+	}
+}
+
+bool wait_until(std::atomic<uint32_t> *addr, uint32_t expected,
+				time::point deadline)
+{
+	time::point now = time::now();
+	if (now >= deadline) {
+		return false;
+	}
+	stripe &s = get_stripe(addr);
+	std::unique_lock lock(s.mutex);
+	if (addr->load() == expected) {
+		s.cv.wait_for(lock, std::chrono::nanoseconds((deadline - now).ns));
+	}
+	return true;
+}
+
+void wake_one(std::atomic<uint32_t> *addr)
+{
+	stripe &s = get_stripe(addr);
+	{
+		std::lock_guard lock(s.mutex);
+	}
+	s.cv.notify_all();
+}
+
+void wake_all(std::atomic<uint32_t> *addr) { wake_one(addr); }
+#endif
+} // namespace futex
+} // namespace concurrent
+
+#endif
@@ -0,0 +1,32 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_FUTEX_HPP
+#define CONCURRENT_FUTEX_HPP
+
+#include <cstdint>
+
+#include <atomic>
+
+#include "time.hpp"
+
+namespace concurrent
+{
+namespace futex
+{
+// Blocks while *addr == expected until woken. May return spuriously.
+void wait(std::atomic<uint32_t> *addr, uint32_t expected);
+
+// Blocks while *addr == expected until woken or deadline (time::now() clock)
+// passes. May return spuriously. Returns false only when deadline passed.
+bool wait_until(std::atomic<uint32_t> *addr, uint32_t expected,
+				time::point deadline);
+
+void wake_one(std::atomic<uint32_t> *addr);
+void wake_all(std::atomic<uint32_t> *addr);
+} // namespace futex
+} // namespace concurrent
+
+#endif
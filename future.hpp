@@ -6,10 +6,19 @@
 #ifndef CONCURRECT_FUTURE_HPP
 #define CONCURRECT_FUTURE_HPP
 
-#include <memory>
+#include <cstdint>
+#include <cstdlib>
+
+#include <tuple>
 #include <atomic>
+#include <vector>
+#include <utility>
+#include <type_traits>
 
 #include "time.hpp"
+#include "futex.hpp"
+#include "object_pool.hpp"
+#include "latency_histogram.hpp"
 
 namespace concurrent {
 	template<typename T>
@@ -17,16 +26,210 @@ namespace concurrent {
 	template<typename T>
 	class promise;
 	
+	// Callback registered on promise_state, run() executes it and releases
+	// node.
+	class continuation_base {
+	public:
+		virtual void run() = 0;
+		
+		continuation_base *next = NULL;
+		
+	protected:
+		~continuation_base() = default;
+	};
+	
+	template<typename T, typename F>
+	class continuation final : public continuation_base {
+	public:
+		using pool = object_pool<continuation<T, F>>;
+		
+		continuation(future<T> &&fut, F &&func)
+			: fut(std::move(fut)), func(std::move(func)) {}
+		
+		void run() override {
+			F f = std::move(func);
+			future<T> ft = std::move(fut);
+			pool::release(this);
+			f(ft);
+		}
+		
+	private:
+		future<T> fut;
+		F func;
+	};
+	
+	// Shared state of promise and its futures, allocated from object_pool and
+	// reference counted intrusively, so single allocation per promise.
 	template<typename T>
 	class promise_state final {
 	public:
-		promise_state() {
-			error.clear();
-			finished.clear();
+		using pool = object_pool<promise_state<T>>;
+		
+		promise_state() = default;
+		
+		static promise_state *create() {
+			return pool::acquire_raw();
 		}
-		std::atomic_flag finished;
+		
+		inline void add_ref() {
+			refs.fetch_add(1, std::memory_order_relaxed);
+		}
+		
+		inline void release_ref() {
+			// Sole owner does not need to write shared refcount at all.
+			if (refs.load(std::memory_order_acquire) == 1 ||
+					refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				pool::release(this);
+			}
+		}
+		
+		inline bool is_finished() const {
+			return finished.load(std::memory_order_acquire) & FINISHED;
+		}
+		
+		// Only the first caller gets true, so completions racing with
+		// timeouts set value at most once. Plain set_value()/set_error()
+		// do not claim.
+		inline bool try_claim() {
+			return (finished.fetch_or(CLAIMED, std::memory_order_acq_rel) &
+					(CLAIMED | FINISHED)) == 0;
+		}
+		
+		bool try_fail() {
+			if (try_claim() == false) {
+				return false;
+			}
+			error.test_and_set(std::memory_order_relaxed);
+			mark_finished();
+			return true;
+		}
+		
+		// Wakes waiters only when any of them announced itself, then runs
+		// continuations in order of registration. Exchange publishes value
+		// and error (release), both it and load of continuations have to be
+		// seq_cst for the handshake with add_continuation().
+		inline void mark_finished() {
+			if (finished.exchange(FINISHED, std::memory_order_seq_cst) & WAITING) {
+				futex::wake_all(&finished);
+			}
+			if (continuations.load(std::memory_order_seq_cst) != NULL) {
+				_internal_run_continuations();
+			}
+		}
+		
+		// Lock-free push, or runs c immediately when state already finished.
+		// Push and check of finished here pair (seq_cst) with store of
+		// finished and check of continuations in mark_finished(), so at least
+		// one side sees the other and takes whole list.
+		void add_continuation(continuation_base *c) {
+			continuation_base *head = continuations.load(std::memory_order_acquire);
+			for (;;) {
+				if (head == CLOSED) {
+					c->run();
+					return;
+				}
+				c->next = head;
+				if (continuations.compare_exchange_weak(head, c,
+							std::memory_order_seq_cst, std::memory_order_acquire)) {
+					break;
+				}
+			}
+			if (finished.load(std::memory_order_seq_cst) & FINISHED) {
+				_internal_run_continuations();
+			}
+		}
+		
+		void wait() {
+			uint32_t v = finished.load(std::memory_order_acquire);
+			if (v & FINISHED) {
+				return;
+			}
+			latency_histogram *hist =
+				latency_hooks::future_wait.load(std::memory_order_relaxed);
+			const time::point start = hist ? time::now_fast() : time::point{};
+			while ((v & FINISHED) == 0) {
+				if (_internal_announce_waiter(v)) {
+					futex::wait(&finished, v);
+					v = finished.load(std::memory_order_acquire);
+				}
+			}
+			if (hist) {
+				hist->record_since(start);
+			}
+		}
+		
+		bool wait_until(time::point deadline) {
+			uint32_t v = finished.load(std::memory_order_acquire);
+			if (v & FINISHED) {
+				return true;
+			}
+			latency_histogram *hist =
+				latency_hooks::future_wait.load(std::memory_order_relaxed);
+			const time::point start = hist ? time::now_fast() : time::point{};
+			while ((v & FINISHED) == 0) {
+				if (_internal_announce_waiter(v)) {
+					if (futex::wait_until(&finished, v, deadline) == false) {
+						v = finished.load(std::memory_order_acquire);
+						break;
+					}
+					v = finished.load(std::memory_order_acquire);
+				}
+			}
+			if (hist) {
+				hist->record_since(start);
+			}
+			return v & FINISHED;
+		}
+		
+		static constexpr uint32_t FINISHED = 1;
+		static constexpr uint32_t WAITING = 2;
+		static constexpr uint32_t CLAIMED = 4;
+		
+		std::atomic<uint32_t> finished = 0;
 		std::atomic_flag error;
+		std::atomic<uint32_t> refs = 1;
+		std::atomic<continuation_base *> continuations = NULL;
 		T value;
+		
+	private:
+		inline static continuation_base *const CLOSED =
+			(continuation_base *)(uintptr_t)1;
+		
+		void _internal_run_continuations() {
+			// Acquires pushed continuations and releases CLOSED, so late
+			// add_continuation() running c immediately sees finished state.
+			continuation_base *c =
+				continuations.exchange(CLOSED, std::memory_order_acq_rel);
+			if (c == CLOSED) {
+				return;
+			}
+			continuation_base *reversed = NULL;
+			while (c != NULL) {
+				continuation_base *next = c->next;
+				c->next = reversed;
+				reversed = c;
+				c = next;
+			}
+			while (reversed != NULL) {
+				continuation_base *next = reversed->next;
+				reversed->run();
+				reversed = next;
+			}
+		}
+		
+
+		// On failure v is reloaded and caller has to recheck it.
+		inline bool _internal_announce_waiter(uint32_t &v) {
+			if (v & WAITING) {
+				return true;
+			}
+			if (finished.compare_exchange_weak(v, v | WAITING,
+						std::memory_order_acq_rel, std::memory_order_acquire)) {
+				v |= WAITING;
+				return true;
+			}
+			return false;
+		}
 	};
 	
 	template<typename T>
@@ -35,58 +238,90 @@ namespace concurrent {
 		promise() {
 		}
 		~promise() {
-			if (state.get() != NULL && finished == false) {
-				state->error.test_and_set();
-				state->finished.test_and_set();
-				state->finished.notify_all();
+			if (state != NULL) {
+				if (finished == false) {
+					state->try_fail();
+				}
+				state->release_ref();
 			}
 		}
-		promise(promise &&) = default;
+		promise(promise &&o) : state(o.state), finished(o.finished) {
+			o.state = NULL;
+		}
 		promise(promise &) = delete;
-		promise &operator=(promise &&) = default;
+		promise &operator=(promise &&o) {
+			std::swap(state, o.state);
+			std::swap(finished, o.finished);
+			return *this;
+		}
 		promise &operator=(promise &) = delete;
 		
 		void set_value(T &&v) {
+			init();
 			finished = true;
 			state->value = std::move(v);
-			state->finished.test_and_set();
-			state->finished.notify_all();
-			state = nullptr;
+			state->mark_finished();
 		}
 		
 		void set_value(T &v) {
+			init();
 			finished = true;
 			state->value = v;
-			state->finished.test_and_set();
-			state->finished.notify_all();
+			state->mark_finished();
 		}
 		
 		void set_value(const T &v) {
+			init();
 			finished = true;
 			state->value = v;
-			state->finished.test_and_set();
-			state->finished.notify_all();
+			state->mark_finished();
 		}
 		
 		void set_error() {
+			init();
+			finished = true;
+			state->error.test_and_set(std::memory_order_relaxed);
+			state->mark_finished();
+		}
+		
+		// Use these when promise may be failed concurrently through
+		// future::try_fail() (e.g. by timer_wheel timeout), returns false and
+		// does nothing if it already was finished.
+		bool try_set_value(T &&v) {
+			init();
+			finished = true;
+			if (state->try_claim() == false) {
+				return false;
+			}
+			state->value = std::move(v);
+			state->mark_finished();
+			return true;
+		}
+		
+		bool try_set_value(const T &v) {
+			T tmp = v;
+			return try_set_value(std::move(tmp));
+		}
+		
+		bool try_set_error() {
+			init();
 			finished = true;
-			state->error.test_and_set();
-			state->finished.test_and_set();
-			state->finished.notify_all();
+			return state->try_fail();
 		}
 		
 		future<T> get_future() {
 			init();
+			state->add_ref();
 			return future<T>(state);
 		}
 		
 	private:
 		void init() {
-			if (state.get() == NULL) {
-				state = std::make_shared<promise_state<T>>();
+			if (state == NULL) {
+				state = promise_state<T>::create();
 			}
 		}
-		std::shared_ptr<promise_state<T>> state;
+		promise_state<T> *state = NULL;
 		bool finished = false;
 	};
 	
@@ -94,80 +329,172 @@ namespace concurrent {
 	class future final {
 	public:
 		future() = default;
-		~future() = default;
-		future(future &&) = default;
-		future(future &) = default;
-		future &operator=(future &&) = default;
-		future &operator=(future &) = default;
+		~future() {
+			if (state != NULL) {
+				state->release_ref();
+			}
+		}
+		future(future &&o) : state(o.state) {
+			o.state = NULL;
+		}
+		future(const future &o) : state(o.state) {
+			if (state != NULL) {
+				state->add_ref();
+			}
+		}
+		future &operator=(future &&o) {
+			std::swap(state, o.state);
+			return *this;
+		}
+		future &operator=(const future &o) {
+			future tmp(o);
+			std::swap(state, tmp.state);
+			return *this;
+		}
 		
 		void wait() {
-			if (state.get() != NULL) {
-				state->finished.wait(false);
+			if (state != NULL) {
+				state->wait();
 			}
 			return;
 		}
 		
-		void wait_for(time::diff wait_time) {
-			wait_for(wait_time, {1000});
+		// Sleeps until promise is finished or deadline passes, returns
+		// finished().
+		bool wait_until(time::point deadline) {
+			if (state != NULL) {
+				return state->wait_until(deadline);
+			}
+			return false;
 		}
 		
-		void wait_for(time::diff wait_time, time::diff atom_sleep) {
-			if (state.get() != NULL) {
-				auto end = time::now() + wait_time;
-				while(state->finished.test() == false && end > time::now()) {
-					time::sleep_for(atom_sleep);
+		bool wait_for(time::diff wait_time) {
+			if (state != NULL) {
+				if (state->is_finished()) {
+					return true;
 				}
+				return state->wait_until(time::now() + wait_time);
 			}
+			return false;
+		}
+		
+		// atom_sleep is ignored, kept for compatibility with polling waits.
+		[[deprecated("atom_sleep is ignored, use wait_for(wait_time)")]]
+		bool wait_for(time::diff wait_time,
+				[[maybe_unused]] time::diff atom_sleep) {
+			return wait_for(wait_time);
 		}
 		
-		void wait_for_nanoseconds(int64_t wait_time) {
-			wait_for(time::nanoseconds(wait_time), time::microseconds(1));
+		bool wait_for_nanoseconds(int64_t wait_time) {
+			return wait_for(time::nanoseconds(wait_time));
 		}
 		
-		void wait_for_microseconds(int64_t wait_time) {
-			wait_for(time::microseconds(wait_time), time::microseconds(1));
+		bool wait_for_microseconds(int64_t wait_time) {
+			return wait_for(time::microseconds(wait_time));
 		}
 		
-		void wait_for_milliseconds(int64_t wait_time) {
-			wait_for(time::milliseconds(wait_time), time::microseconds(1));
+		bool wait_for_milliseconds(int64_t wait_time) {
+			return wait_for(time::milliseconds(wait_time));
 		}
 		
-		void wait_for_seconds(double wait_time) {
-			wait_for(time::seconds(wait_time), time::microseconds(1));
+		bool wait_for_seconds(double wait_time) {
+			return wait_for(time::seconds(wait_time));
 		}
 		
 		bool is_valid() const {
-			if (state.get() != NULL) {
-				return !state->error.test();
+			if (state != NULL) {
+				return !state->error.test(std::memory_order_acquire);
 			}
 			return false;
 		}
 		
 		bool has_value() const {
-			if (state.get() != NULL) {
-				return state->finishied.test() && !state->error.test();
+			if (state != NULL) {
+				return state->is_finished() &&
+					!state->error.test(std::memory_order_relaxed);
 			}
 			return false;
 		}
 		
+		//	Aborts on future without state (default constructed or moved
+		//	from), check has_any_state() first when unsure.
 		T &get() {
-			if (state.get() != NULL) {
-				if (state->finished.test() == false) {
-					wait();
-				}
-				return state->value;
+			if (state == NULL) {
+				abort();
+			}
+			if (state->is_finished() == false) {
+				state->wait();
 			}
-			// TODO: maybe throw error instead?
 			return state->value;
 		}
 		
 		bool has_any_state() const {
-			return state.get() != NULL;
+			return state != NULL;
 		}
 		
 		bool finished() const {
-			if (state.get() != NULL) {
-				return state->finished.test();
+			if (state != NULL) {
+				return state->is_finished();
+			}
+			return false;
+		}
+		
+		// Calls func(future<T>&) once promise is finished (with value or
+		// error), on thread finishing promise or on calling thread when
+		// already finished or without state. Never blocks.
+		template<typename F>
+		void on_finish(F &&func) {
+			using F2 = std::decay_t<F>;
+			if (state == NULL) {
+				func(*this);
+				return;
+			}
+			state->add_continuation(continuation<T, F2>::pool::acquire_raw(
+						future(*this), F2(std::forward<F>(func))));
+		}
+		
+		// As above, but func is passed to executor.execute(), which has to
+		// outlive this promise.
+		template<typename F, typename E>
+		void on_finish(F &&func, E &executor) {
+			on_finish([func = std::forward<F>(func), &executor](future<T> &self) mutable {
+						executor.execute([func = std::move(func), self]() mutable {
+								func(self);
+							});
+					});
+		}
+		
+		// Returns future of func(future<T>&) result, func is called as in
+		// on_finish().
+		template<typename F>
+		auto then(F &&func) -> future<std::invoke_result_t<F &, future<T> &>> {
+			using R = std::invoke_result_t<F &, future<T> &>;
+			static_assert(!std::is_void_v<R>, "then continuation must return a value, use on_finish instead");
+			promise<R> p;
+			future<R> ret = p.get_future();
+			on_finish([p = std::move(p), func = std::forward<F>(func)](future<T> &self) mutable {
+						p.set_value(func(self));
+					});
+			return ret;
+		}
+		
+		template<typename F, typename E>
+		auto then(F &&func, E &executor) -> future<std::invoke_result_t<F &, future<T> &>> {
+			using R = std::invoke_result_t<F &, future<T> &>;
+			static_assert(!std::is_void_v<R>, "then continuation must return a value, use on_finish instead");
+			promise<R> p;
+			future<R> ret = p.get_future();
+			on_finish([p = std::move(p), func = std::forward<F>(func)](future<T> &self) mutable {
+						p.set_value(func(self));
+					}, executor);
+			return ret;
+		}
+		
+		// Finishes promise with error unless it was already finished or
+		// claimed by promise::try_set_value(). Returns whether it did.
+		bool try_fail() {
+			if (state != NULL) {
+				return state->try_fail();
 			}
 			return false;
 		}
@@ -175,10 +502,112 @@ namespace concurrent {
 		friend class promise<T>;
 		
 	private:
-		future(std::shared_ptr<promise_state<T>> state) : state(state) {}
+		// Takes ownership of one reference.
+		future(promise_state<T> *state) : state(state) {}
 		
-		std::shared_ptr<promise_state<T>> state;
+		promise_state<T> *state = NULL;
+	};
+	
+	// Finishes once all futures finished, without blocking any thread.
+	template<typename T>
+	future<std::vector<future<T>>> when_all(std::vector<future<T>> futures) {
+		using result = std::vector<future<T>>;
+		struct all_state {
+			promise<result> p;
+			result futures;
+			std::atomic<size_t> remaining;
+			
+			// Last finishing one publishes result.
+			void finish_one() {
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					p.set_value(std::move(futures));
+					object_pool<all_state>::release(this);
+				}
+			}
+		};
+		all_state *s = object_pool<all_state>::acquire_raw();
+		future<result> ret = s->p.get_future();
+		// One extra count guards state while continuations are registered.
+		s->remaining.store(futures.size() + 1, std::memory_order_relaxed);
+		s->futures = std::move(futures);
+		for (future<T> &f : s->futures) {
+			f.on_finish([s](future<T> &) { s->finish_one(); });
+		}
+		s->finish_one();
+		return ret;
+	}
+	
+	template<typename... Ts>
+	future<std::tuple<future<Ts>...>> when_all(future<Ts>... futures) {
+		using result = std::tuple<future<Ts>...>;
+		struct all_state {
+			promise<result> p;
+			result futures;
+			std::atomic<size_t> remaining;
+			
+			void finish_one() {
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					p.set_value(std::move(futures));
+					object_pool<all_state>::release(this);
+				}
+			}
+		};
+		all_state *s = object_pool<all_state>::acquire_raw();
+		future<result> ret = s->p.get_future();
+		s->remaining.store(sizeof...(Ts) + 1, std::memory_order_relaxed);
+		s->futures = result(std::move(futures)...);
+		std::apply([s](auto &...f) {
+					(f.on_finish([s](auto &) { s->finish_one(); }), ...);
+				}, s->futures);
+		s->finish_one();
+		return ret;
+	}
+	
+	template<typename T>
+	struct when_any_result {
+		// Index of first finished future, or (size_t)-1 for empty input.
+		size_t index = (size_t)-1;
+		std::vector<future<T>> futures;
 	};
+	
+	// Finishes once any of futures finished, without blocking any thread.
+	template<typename T>
+	future<when_any_result<T>> when_any(std::vector<future<T>> futures) {
+		using result = when_any_result<T>;
+		struct any_state {
+			promise<result> p;
+			std::vector<future<T>> futures;
+			std::atomic<size_t> remaining;
+			std::atomic<bool> done;
+			
+			void release_one() {
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					object_pool<any_state>::release(this);
+				}
+			}
+		};
+		if (futures.empty()) {
+			promise<result> p;
+			future<result> ret = p.get_future();
+			p.set_value(result{});
+			return ret;
+		}
+		any_state *s = object_pool<any_state>::acquire_raw();
+		future<result> ret = s->p.get_future();
+		s->remaining.store(futures.size() + 1, std::memory_order_relaxed);
+		s->done.store(false, std::memory_order_relaxed);
+		s->futures = std::move(futures);
+		for (size_t i=0; i<s->futures.size(); ++i) {
+			s->futures[i].on_finish([s, i](future<T> &) {
+						if (s->done.exchange(true, std::memory_order_acq_rel) == false) {
+							s->p.set_value(result{i, s->futures});
+						}
+						s->release_one();
+					});
+		}
+		s->release_one();
+		return ret;
+	}
 }
 
 #endif
@@ -0,0 +1,277 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_LATENCY_HISTOGRAM_HPP
+#define CONCURRENT_LATENCY_HISTOGRAM_HPP
+
+#include <cstdint>
+
+#include <atomic>
+#include <vector>
+
+#include "time.hpp"
+
+namespace concurrent
+{
+//	Log-linear (HDR style) histogram of time::diff values. Each power of two
+//	range is split into SUB_BUCKETS linear buckets, so relative error of
+//	reported values is below 1/SUB_BUCKETS (~3%). Recording is wait-free:
+//	each live thread owns one of SHARDS-1 lazily allocated shards and bumps
+//	its counters with plain relaxed load and store, threads beyond that share
+//	last shard using fetch_add. Readers merge all shards into snapshot.
+class latency_histogram
+{
+public:
+	static constexpr int SUB_BITS = 5;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+	static constexpr int BUCKETS = (64 - SUB_BITS) * SUB_BUCKETS;
+	static constexpr size_t SHARDS = 64;
+
+	class snapshot
+	{
+	public:
+		//	Upper bound of bucket containing q-quantile (q in [0, 1]),
+		//	clamped to recorded maximum.
+		time::diff percentile(double q) const {
+			if (total == 0) {
+				return {0};
+			}
+			uint64_t rank = (uint64_t)(q * total);
+			if (rank >= total) {
+				rank = total - 1;
+			}
+			uint64_t seen = 0;
+			for (int i = 0; i < BUCKETS; ++i) {
+				seen += counts[i];
+				if (seen > rank) {
+					const int64_t v = bucket_upper_bound(i);
+					return {v < max_ns ? v : max_ns};
+				}
+			}
+			return {max_ns};
+		}
+
+		time::diff p50() const { return percentile(0.5); }
+		time::diff p99() const { return percentile(0.99); }
+		time::diff p999() const { return percentile(0.999); }
+		time::diff max() const { return {max_ns}; }
+		time::diff min() const { return {total ? min_ns : 0}; }
+		time::diff mean() const {
+			return {total ? (int64_t)(sum_ns / total) : 0};
+		}
+		uint64_t count() const { return total; }
+
+		std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS, 0);
+		uint64_t total = 0;
+		uint64_t sum_ns = 0;
+		int64_t max_ns = 0;
+		int64_t min_ns = INT64_MAX;
+	};
+
+public:
+	latency_histogram() = default;
+	~latency_histogram() {
+		for (size_t i = 0; i < SHARDS; ++i) {
+			delete shards[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	latency_histogram(const latency_histogram &) = delete;
+	latency_histogram(latency_histogram &&) = delete;
+	latency_histogram &operator=(const latency_histogram &) = delete;
+	latency_histogram &operator=(latency_histogram &&) = delete;
+
+	//	Safe to call from any thread. Negative values are recorded as 0.
+	inline void record(time::diff d) {
+		const uint64_t v = d.ns > 0 ? d.ns : 0;
+		const size_t index = _internal_thread_index();
+		shard &s = _internal_shard(index);
+		if (index != SHARED_SHARD) {
+			std::atomic<uint64_t> &c = s.counts[bucket_index(v)];
+			c.store(c.load(std::memory_order_relaxed) + 1,
+					std::memory_order_relaxed);
+			s.sum.store(s.sum.load(std::memory_order_relaxed) + v,
+					std::memory_order_relaxed);
+		} else {
+			s.counts[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+			s.sum.fetch_add(v, std::memory_order_relaxed);
+		}
+		if ((int64_t)v > s.max.load(std::memory_order_relaxed)) {
+			_internal_update_max(s, v);
+		}
+		if ((int64_t)v < s.min.load(std::memory_order_relaxed)) {
+			_internal_update_min(s, v);
+		}
+	}
+
+	//	Records time elapsed since start, taken with time::now_fast().
+	inline void record_since(time::point start) {
+		record(time::now_fast() - start);
+	}
+
+	//	Merges all shards, concurrent records may or may not be included.
+	snapshot read() const {
+		snapshot r;
+		for (size_t i = 0; i < SHARDS; ++i) {
+			const shard *s = shards[i].load(std::memory_order_acquire);
+			if (s == NULL) {
+				continue;
+			}
+			for (int b = 0; b < BUCKETS; ++b) {
+				r.counts[b] += s->counts[b].load(std::memory_order_relaxed);
+			}
+			r.sum_ns += s->sum.load(std::memory_order_relaxed);
+			const int64_t mx = s->max.load(std::memory_order_relaxed);
+			const int64_t mn = s->min.load(std::memory_order_relaxed);
+			r.max_ns = mx > r.max_ns ? mx : r.max_ns;
+			r.min_ns = mn < r.min_ns ? mn : r.min_ns;
+		}
+		for (int b = 0; b < BUCKETS; ++b) {
+			r.total += r.counts[b];
+		}
+		return r;
+	}
+
+	//	Not atomic with respect to concurrent record() calls.
+	void reset() {
+		for (size_t i = 0; i < SHARDS; ++i) {
+			shard *s = shards[i].load(std::memory_order_acquire);
+			if (s == NULL) {
+				continue;
+			}
+			for (int b = 0; b < BUCKETS; ++b) {
+				s->counts[b].store(0, std::memory_order_relaxed);
+			}
+			s->sum.store(0, std::memory_order_relaxed);
+			s->max.store(0, std::memory_order_relaxed);
+			s->min.store(INT64_MAX, std::memory_order_relaxed);
+		}
+	}
+
+	static inline int bucket_index(uint64_t v) {
+		if (v < SUB_BUCKETS) {
+			return (int)v;
+		}
+		const int e = 63 - __builtin_clzll(v);
+		const int sub = (int)(v >> (e - SUB_BITS)) & (SUB_BUCKETS - 1);
+		return (e - SUB_BITS + 1) * SUB_BUCKETS + sub;
+	}
+
+	//	Largest value mapped to bucket i.
+	static inline int64_t bucket_upper_bound(int i) {
+		if (i < SUB_BUCKETS) {
+			return i;
+		}
+		const int e = i / SUB_BUCKETS + SUB_BITS - 1;
+		const uint64_t sub = i & (SUB_BUCKETS - 1);
+		const uint64_t low = ((uint64_t)SUB_BUCKETS + sub) << (e - SUB_BITS);
+		const uint64_t v = low + ((uint64_t)1 << (e - SUB_BITS)) - 1;
+		return v > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t)v;
+	}
+
+private:
+	struct alignas(64) shard {
+		std::atomic<uint64_t> sum = 0;
+		std::atomic<int64_t> max = 0;
+		std::atomic<int64_t> min = INT64_MAX;
+		std::atomic<uint64_t> counts[BUCKETS] = {};
+	};
+
+	static constexpr size_t SHARED_SHARD = SHARDS - 1;
+	static_assert(SHARDS <= 64, "ownership of shards is tracked in 64 bit mask");
+
+	//	Claims free exclusive shard index for lifetime of thread, shared by
+	//	all histograms. Release and acquire on mask order writes of exited
+	//	thread before writes of next owner.
+	struct thread_shard {
+		thread_shard() {
+			uint64_t mask = owned_mask().load(std::memory_order_relaxed);
+			for (;;) {
+				const uint64_t free = ~mask & ((uint64_t(1) << SHARED_SHARD) - 1);
+				if (free == 0) {
+					return;
+				}
+				const size_t i = __builtin_ctzll(free);
+				if (owned_mask().compare_exchange_weak(mask,
+							mask | (uint64_t(1) << i),
+							std::memory_order_acquire,
+							std::memory_order_relaxed)) {
+					index = i;
+					return;
+				}
+			}
+		}
+		~thread_shard() {
+			if (index != SHARED_SHARD) {
+				owned_mask().fetch_and(~(uint64_t(1) << index),
+						std::memory_order_release);
+			}
+		}
+
+		static std::atomic<uint64_t> &owned_mask() {
+			static std::atomic<uint64_t> mask = 0;
+			return mask;
+		}
+
+		size_t index = SHARED_SHARD;
+	};
+
+	static inline size_t _internal_thread_index() {
+		thread_local thread_shard shard;
+		return shard.index;
+	}
+
+	inline shard &_internal_shard(size_t index) {
+		std::atomic<shard *> &slot = shards[index];
+		shard *s = slot.load(std::memory_order_acquire);
+		if (s == NULL) {
+			s = _internal_create_shard(slot);
+		}
+		return *s;
+	}
+
+	shard *_internal_create_shard(std::atomic<shard *> &slot) {
+		shard *s = new shard();
+		shard *expected = NULL;
+		if (slot.compare_exchange_strong(expected, s,
+					std::memory_order_acq_rel, std::memory_order_acquire)) {
+			return s;
+		}
+		delete s;
+		return expected;
+	}
+
+	void _internal_update_max(shard &s, int64_t v) {
+		int64_t cur = s.max.load(std::memory_order_relaxed);
+		while (v > cur && !s.max.compare_exchange_weak(cur, v,
+					std::memory_order_relaxed)) {
+		}
+	}
+
+	void _internal_update_min(shard &s, int64_t v) {
+		int64_t cur = s.min.load(std::memory_order_relaxed);
+		while (v < cur && !s.min.compare_exchange_weak(cur, v,
+					std::memory_order_relaxed)) {
+		}
+	}
+
+private:
+	std::atomic<shard *> shards[SHARDS] = {};
+};
+
+//	Optional histograms fed by blocking paths of library primitives. NULL
+//	(default) disables recording, costing single relaxed load on the slow
+//	path only. Assigned histogram has to outlive all users.
+namespace latency_hooks
+{
+//	Time spent by future::wait*() sleeping in kernel.
+inline std::atomic<latency_histogram *> future_wait = NULL;
+//	Time of thread_local_pool refill from global buckets_pool, including
+//	waiting on its mutex and system allocation.
+inline std::atomic<latency_histogram *> pool_refill = NULL;
+} // namespace latency_hooks
+}
+
+#endif
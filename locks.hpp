@@ -0,0 +1,149 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_LOCKS_HPP
+#define CONCURRENT_LOCKS_HPP
+
+#include <cstdint>
+
+#include <atomic>
+
+#include "backoff.hpp"
+#include "futex.hpp"
+
+namespace concurrent
+{
+//	Lockable alternatives of std::mutex for very short critical sections,
+//	usable as Lock parameter of mpmc_stack, buckets_pool and
+//	thread_safe_value. Wrap with stat_lock_guard to measure wait and hold
+//	times.
+
+//	Test and test-and-set spinlock. Waiters spin on plain load, so cache
+//	line is not written until lock looks free, and back off exponentially.
+//	Fastest when uncontended, unfair.
+class ttas_spinlock
+{
+public:
+	inline void lock() {
+		exponential_backoff backoff;
+		while (locked.exchange(true, std::memory_order_acquire)) {
+			while (locked.load(std::memory_order_relaxed)) {
+				backoff.pause();
+			}
+		}
+	}
+
+	inline bool try_lock() {
+		return locked.load(std::memory_order_relaxed) == false &&
+			locked.exchange(true, std::memory_order_acquire) == false;
+	}
+
+	inline void unlock() {
+		locked.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> locked = false;
+};
+
+//	FIFO ticket lock, fair under heavy contention. Waiter yields when far
+//	from head of queue and otherwise backs off exponentially, which also
+//	ends in yielding, so preempted holder does not stall its successors for
+//	whole time slice.
+class ticket_lock
+{
+public:
+	static constexpr uint32_t YIELD_DISTANCE = 4;
+
+	inline void lock() {
+		const uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+		exponential_backoff backoff;
+		for (;;) {
+			const uint32_t s = serving.load(std::memory_order_acquire);
+			if (s == ticket) {
+				return;
+			}
+			if (ticket - s >= YIELD_DISTANCE) {
+				std::this_thread::yield();
+			} else {
+				backoff.pause();
+			}
+		}
+	}
+
+	//	Previous holder releases through serving, so that is where acquire
+	//	has to be, CAS on next only claims the ticket.
+	inline bool try_lock() {
+		uint32_t s = serving.load(std::memory_order_acquire);
+		return next.compare_exchange_strong(s, s + 1,
+				std::memory_order_relaxed, std::memory_order_relaxed);
+	}
+
+	inline void unlock() {
+		serving.store(serving.load(std::memory_order_relaxed) + 1,
+				std::memory_order_release);
+	}
+
+private:
+	alignas(64) std::atomic<uint32_t> next = 0;
+	alignas(64) std::atomic<uint32_t> serving = 0;
+};
+
+//	Spins briefly, then sleeps in futex. Unlock enters kernel only when some
+//	thread sleeps. States: 0 unlocked, 1 locked, 2 locked with possible
+//	sleepers. Requires linking futex.cpp.
+class hybrid_mutex
+{
+public:
+	static constexpr int SPIN_LIMIT = 100;
+
+	inline void lock() {
+		uint32_t c = UNLOCKED;
+		if (state.compare_exchange_strong(c, LOCKED,
+					std::memory_order_acquire, std::memory_order_relaxed)) {
+			return;
+		}
+		_internal_lock_slow(c);
+	}
+
+	inline bool try_lock() {
+		uint32_t c = UNLOCKED;
+		return state.compare_exchange_strong(c, LOCKED,
+				std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	inline void unlock() {
+		if (state.exchange(UNLOCKED, std::memory_order_release) == SLEEPERS) {
+			futex::wake_one(&state);
+		}
+	}
+
+private:
+	static constexpr uint32_t UNLOCKED = 0;
+	static constexpr uint32_t LOCKED = 1;
+	static constexpr uint32_t SLEEPERS = 2;
+
+	void _internal_lock_slow(uint32_t c) {
+		for (int i = 0; i < SPIN_LIMIT && c != SLEEPERS; ++i) {
+			if (c == UNLOCKED && state.compare_exchange_weak(c, LOCKED,
+						std::memory_order_acquire, std::memory_order_relaxed)) {
+				return;
+			}
+			cpu_relax();
+			c = state.load(std::memory_order_relaxed);
+		}
+		// Woken thread can not know whether others still sleep, so it takes
+		// the lock in SLEEPERS state.
+		while (state.exchange(SLEEPERS, std::memory_order_acquire) != UNLOCKED) {
+			futex::wait(&state, SLEEPERS);
+		}
+	}
+
+private:
+	std::atomic<uint32_t> state = UNLOCKED;
+};
+}
+
+#endif
@@ -6,15 +6,103 @@
 #ifndef POOL_MPMC_STACK_HPP
 #define POOL_MPMC_STACK_HPP
 
+#include <cstdint>
+
+#include <atomic>
 #include <mutex>
+#include <thread>
 
 #include "mpsc_stack.hpp"
+#include "contention_stats.hpp"
 
 namespace concurrent
 {
 namespace mpmc
 {
+namespace detail
+{
+//	Slots where push that lost race for head offers its node and waits
+//	briefly for pop that could not get the lock to take it, so colliding
+//	pair completes without touching head nor lock. Slot holds offered node
+//	or NULL. Withdrawing offer is CAS from own node, if same node got taken
+//	and offered again meanwhile, whoever withdraws it pushes it to stack,
+//	so every node still ends up in exactly one place.
+template<typename T, size_t SLOTS>
+class elimination_array {
+public:
+	static constexpr uint32_t OFFER_SPINS = 128;
+	
+	//	true when node was taken by pop
+	inline bool offer(T* node) {
+		std::atomic<T*> &slot = slots[_internal_random_slot()].node;
+		T* expected = NULL;
+		node->__m_next.store(NULL, std::memory_order_relaxed);
+		if (slot.compare_exchange_strong(expected, node,
+					std::memory_order_release, std::memory_order_relaxed)
+				== false) {
+			return false;
+		}
+		for (uint32_t i = 0; i < OFFER_SPINS; ++i) {
+			if (slot.load(std::memory_order_relaxed) != node) {
+				return true;
+			}
+			cpu_relax();
+		}
+		//	Acquire, withdrawn node may be one that was taken and offered
+		//	again by other thread, whose writes to it have to be visible.
+		expected = node;
+		return slot.compare_exchange_strong(expected, NULL,
+				std::memory_order_acquire, std::memory_order_relaxed) == false;
+	}
+	
+	//	Scans all slots once starting at random one, NULL when none offered.
+	inline T* take() {
+		const uint32_t start = _internal_random_slot();
+		for (uint32_t i = 0; i < SLOTS; ++i) {
+			std::atomic<T*> &slot = slots[(start + i) % SLOTS].node;
+			T* node = slot.load(std::memory_order_relaxed);
+			if (node != NULL && slot.compare_exchange_strong(node, NULL,
+						std::memory_order_acquire,
+						std::memory_order_relaxed)) {
+				return node;
+			}
+		}
+		return NULL;
+	}
+	
+private:
+	static inline uint32_t _internal_random_slot() {
+		thread_local uint32_t seed =
+			(uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed % SLOTS;
+	}
+	
+	struct alignas(64) slot {
+		std::atomic<T*> node = NULL;
+	};
+	
+	slot slots[SLOTS];
+};
+
 template<typename T>
+class elimination_array<T, 0> {
+};
+} // namespace detail
+
+//	Lock serializes poppers, std::mutex or any of locks.hpp. Backoff is
+//	applied after failed CAS of underlying mpsc::stack, see backoff.hpp.
+//
+//	ELIMINATION_SLOTS > 0 puts elimination array in front of the stack, for
+//	free-lists where pushes and pops come in similar numbers from many
+//	threads: push that loses CAS on head and pop that finds lock taken meet
+//	in one of the slots and exchange node directly. Uncontended operations
+//	do not touch the array. Costs 64 bytes per slot, use around half of
+//	number of contending threads.
+template<typename T, typename Lock = std::mutex,
+		typename Backoff = exponential_backoff, size_t ELIMINATION_SLOTS = 0>
 class mpmc_stack {
 public:
 	
@@ -26,18 +114,20 @@ public:
 	mpmc_stack() {}
 	~mpmc_stack() {}
 	
+	//	mpsc::stack::pop() is safe with concurrent pushes, mutex serializes
+	//	poppers
 	inline T* pop() {
-		std::lock_guard<std::mutex> lock(mutex);
-		for(;;) {
-			T* value = stack.first;
-			if(value == NULL)
-				return NULL;
-			T* next = value->__m_next;
-			if(stack.first.compare_exchange_strong(value, next)) {
-				return value;
+		if constexpr (ELIMINATION_SLOTS > 0) {
+			if (mutex.try_lock()) {
+				std::lock_guard lock(mutex, std::adopt_lock);
+				return stack.pop();
+			}
+			if (T* node = elimination.take()) {
+				return node;
 			}
 		}
-		return NULL;
+		stat_lock_guard lock(mutex, contention);
+		return stack.pop();
 	}
 	
 	//	safe to call with concurrent push, but without concurrent pop
@@ -47,7 +137,7 @@ public:
 	
 	//	pop whole stack at once, caller must handle returned list
 	inline T* pop_all() {
-		std::lock_guard<std::mutex> lock(mutex);
+		stat_lock_guard lock(mutex, contention);
 		return stack.pop_all();
 	}
 	
@@ -59,11 +149,16 @@ public:
 	//	safe to call without concurrent pop
 	//	pop whole stack at once, caller must handle returned list
 	inline T* pop_all_unsafe() {
-		std::lock_guard<std::mutex> lock(mutex);
+		stat_lock_guard lock(mutex, contention);
 		return stack.pop_all();
 	}
 	
 	inline void push(T* new_node) {
+		if constexpr (ELIMINATION_SLOTS > 0) {
+			if (stack.try_push(new_node) || elimination.offer(new_node)) {
+				return;
+			}
+		}
 		stack.push(new_node);
 	}
 	
@@ -90,10 +185,25 @@ public:
 		stack.reverse_unsafe();
 	}
 	
+	//	Pop lock wait and hold times, CAS retries of underlying stack are
+	//	reported by get_stack_contention_stats(). All zero unless compiled
+	//	with CONCURRENT_CONTENTION_STATS. With elimination only pops which
+	//	found lock taken are counted.
+	inline contention_snapshot get_contention_stats() const {
+		return contention.snapshot();
+	}
+	
+	inline contention_snapshot get_stack_contention_stats() const {
+		return stack.get_contention_stats();
+	}
+	
 private:
 	
-	std::mutex mutex;
-	mpsc::stack<T> stack;
+	Lock mutex;
+	[[no_unique_address]] contention_counters contention;
+	mpsc::stack<T, Backoff> stack;
+	[[no_unique_address]] detail::elimination_array<T, ELIMINATION_SLOTS>
+		elimination;
 };
 }
 }
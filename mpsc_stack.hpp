@@ -10,10 +10,13 @@
 #include <cstdlib>
 
 #include "node_stack.hpp"
+#include "contention_stats.hpp"
+#include "backoff.hpp"
 
 namespace concurrent {
 	namespace mpsc {
-		template<typename T>
+		// Backoff is applied after failed CAS, see backoff.hpp.
+		template<typename T, typename Backoff = exponential_backoff>
 		class stack {
 		public:
 			
@@ -40,33 +43,52 @@ namespace concurrent {
 			inline stack& operator=(const stack&) = delete;
 			
 			// safe concurrently only without any other pop() not pop_all()
+			//
+			// Pushers publish nodes with release CAS on head, consumers
+			// acquire it, so links of taken nodes may be read relaxed. Each
+			// pushing CAS is RMW, so it continues release sequence of
+			// previous pushes and single acquire covers whole list.
 			inline T* pop() {
+				T* first = head.load(std::memory_order_acquire);
+				Backoff backoff;
 				for(;;) {
-					T* first = head;
 					if(first == NULL)
 						return NULL;
-					T* next = first->__m_next.load();
-					if(head.compare_exchange_strong(first, next)) {
-						first->__m_next.store(NULL);
+					T* next = first->__m_next.load(std::memory_order_relaxed);
+					if(head.compare_exchange_strong(first, next,
+								std::memory_order_acquire,
+								std::memory_order_acquire)) {
+						first->__m_next.store(NULL, std::memory_order_relaxed);
 						return first;
 					}
+					contention.add_cas_failure();
+					backoff.pause();
+					first = head.load(std::memory_order_acquire);
 				}
 				return NULL;
 			}
 			
 			inline void push(T* new_elem) {
-				new_elem->__m_next.store(NULL);
+				new_elem->__m_next.store(NULL, std::memory_order_relaxed);
 				push_all(new_elem, new_elem);
 			}
 			
+			// Single CAS attempt, false when it lost race for head, so
+			// caller may try something else than retrying on same line.
+			inline bool try_push(T* new_elem) {
+				T *old_head = head.load(std::memory_order_relaxed);
+				new_elem->__m_next.store(old_head, std::memory_order_relaxed);
+				if(head.compare_exchange_strong(old_head, new_elem,
+							std::memory_order_release,
+							std::memory_order_relaxed))
+					return true;
+				contention.add_cas_failure();
+				return false;
+			}
+			
 			// safe with other pop_all() but not with pop()
 			inline T* pop_all() {
-				for(;;) {
-					T* first = head;
-					if(head.compare_exchange_weak(first, NULL))
-						return first;
-				}
-				return NULL;
+				return head.exchange(NULL, std::memory_order_acquire);
 			}
 			
 			inline void push_all(T* first) {
@@ -75,11 +97,17 @@ namespace concurrent {
 			}
 			
 			inline void push_all(T* first, T* last) {
+				T *old_head = head.load(std::memory_order_relaxed);
+				Backoff backoff;
 				for(;;) {
-					T *old_head = head.load();
-					last->__m_next.store(old_head);
-					if(head.compare_exchange_weak(old_head, first))
+					last->__m_next.store(old_head, std::memory_order_relaxed);
+					if(head.compare_exchange_weak(old_head, first,
+								std::memory_order_release,
+								std::memory_order_relaxed))
 						return;
+					contention.add_cas_failure();
+					backoff.pause();
+					old_head = head.load(std::memory_order_relaxed);
 				}
 			}
 			
@@ -89,13 +117,20 @@ namespace concurrent {
 				push_all(first, last);
 			}
 			
+			// Only a hint, does not synchronize with pushers.
 			inline bool empty() const {
-				return !head;
+				return head.load(std::memory_order_relaxed) == NULL;
+			}
+			
+			// All zero unless compiled with CONCURRENT_CONTENTION_STATS.
+			inline contention_snapshot get_contention_stats() const {
+				return contention.snapshot();
 			}
 			
 		private:
 			
 			std::atomic<T*> head;
+			[[no_unique_address]] contention_counters contention;
 		};
 		
 	}
@@ -27,12 +27,12 @@ namespace concurrent {
 			iterator& operator=(node<T>* it) { this->it = it; return *this; }
 			
 			inline iterator& operator++() {
-				it = it!=NULL?it->__m_next.load() : NULL;
+				it = it!=NULL?it->__m_next.load(std::memory_order_relaxed) : NULL;
 				return *this;
 			}
 			inline iterator operator++(int) {
 				iterator old = *this;
-				it = it!=NULL?it->__m_next.load() : NULL;
+				it = it!=NULL?it->__m_next.load(std::memory_order_relaxed) : NULL;
 				return old;
 			}
 			
@@ -70,12 +70,12 @@ namespace concurrent {
 			}
 			
 			inline const_iterator& operator++() {
-				it = it!=NULL?it->__m_next.load() : NULL;
+				it = it!=NULL?it->__m_next.load(std::memory_order_relaxed) : NULL;
 				return *this;
 			}
 			inline const_iterator operator++(int) {
 				const_iterator old = *this;
-				it = it!=NULL?it->__m_next.load() : NULL;
+				it = it!=NULL?it->__m_next.load(std::memory_order_relaxed) : NULL;
 				return old;
 			}
 			
@@ -109,15 +109,20 @@ namespace concurrent {
 		const_iterator __f_begin() const { return const_iterator(this); }
 		const_iterator __f_end() const { return const_iterator(); }
 		
+		// Links are read relaxed: lists are walked only after being detached
+		// with acquire (pop_all()) or before being published with release
+		// (push_all()).
 		inline T*const __f_last() const {
-			T*const it = (T*)this;
-			for(; it->__m_next; it=it->__m_next) {
+			T* it = (T*)this;
+			for(T* n; (n = it->__m_next.load(std::memory_order_relaxed));
+					it = n) {
 			}
 			return it;
 		}
 		inline T* __f_last() {
 			T* it = (T*)this;
-			for(; it->__m_next; it=it->__m_next) {
+			for(T* n; (n = it->__m_next.load(std::memory_order_relaxed));
+					it = n) {
 			}
 			return it;
 		}
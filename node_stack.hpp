@@ -8,6 +8,8 @@
 
 #include <cstdlib>
 
+#include <atomic>
+
 #include "node.hpp"
 
 namespace nonconcurrent {
@@ -36,14 +38,14 @@ namespace nonconcurrent {
 			T* first = head;
 			if(first == NULL)
 				return NULL;
-			head = first->__m_next;
-			first->__m_next = NULL;
+			head = first->__m_next.load(std::memory_order_relaxed);
+			first->__m_next.store(NULL, std::memory_order_relaxed);
 			return first;
 		}
 		
 		inline void push(T* new_elem) {
-			new_elem->__m_next = NULL;
-			push_all(new_elem);
+			new_elem->__m_next.store(head, std::memory_order_relaxed);
+			head = new_elem;
 		}
 		
 		inline T* pop_all() {
@@ -57,13 +59,13 @@ namespace nonconcurrent {
 				head = first;
 			} else {
 				T* last = first->__f_last();
-				last->__m_next = head;
+				last->__m_next.store(head, std::memory_order_relaxed);
 				head = first;
 			}
 		}
 		
 		inline void push_all(T* first, T* last) {
-			last->__m_next = head;
+			last->__m_next.store(head, std::memory_order_relaxed);
 			head = first;
 		}
 		
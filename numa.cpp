@@ -0,0 +1,188 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_NUMA_CPP
+#define CONCURRENT_NUMA_CPP
+
+#include <cstdio>
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <fstream>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#if defined(CONCURRENT_USE_LIBNUMA)
+#include <numa.h>
+#endif
+
+#include "numa.hpp"
+
+namespace concurrent
+{
+namespace numa
+{
+namespace
+{
+struct topology {
+	topology()
+	{
+#if defined(CONCURRENT_USE_LIBNUMA)
+		if (numa_available() >= 0) {
+			nodes = numa_max_node() + 1;
+			int cpus = numa_num_configured_cpus();
+			cpu_to_node.resize(cpus > 0 ? cpus : 0, 0);
+			for (int i = 0; i < cpus; ++i) {
+				int n = numa_node_of_cpu(i);
+				cpu_to_node[i] = n < 0 ? 0 : n;
+			}
+			distances.resize(nodes * nodes, 0);
+			for (size_t a = 0; a < nodes; ++a) {
+				for (size_t b = 0; b < nodes; ++b) {
+					distances[a * nodes + b] = numa_distance(a, b);
+				}
+			}
+			return;
+		}
+#endif
+		// Node ids may have gaps (e.g. "0,2-3"), so ids are taken from online
+		// list instead of probing node0, node1, ... until first missing.
+		std::ifstream online("/sys/devices/system/node/online");
+		std::string ids;
+		if (online) {
+			std::getline(online, ids);
+		}
+		std::vector<size_t> online_nodes;
+		for_each_in_list(ids, [this, &online_nodes](size_t node) {
+			online_nodes.push_back(node);
+			std::ifstream file("/sys/devices/system/node/node" +
+							   std::to_string(node) + "/cpulist");
+			if (!file) {
+				return;
+			}
+			std::string list;
+			std::getline(file, list);
+			for_each_in_list(list, [this, node](size_t cpu) {
+				if (cpu >= cpu_to_node.size()) {
+					cpu_to_node.resize(cpu + 1, 0);
+				}
+				cpu_to_node[cpu] = node;
+			});
+			nodes = std::max(nodes, node + 1);
+		});
+		if (nodes == 0) {
+			nodes = 1;
+		}
+		// Row of nodeN/distance lists distances to online nodes in order.
+		distances.resize(nodes * nodes, 0);
+		for (size_t a : online_nodes) {
+			std::ifstream file("/sys/devices/system/node/node" +
+							   std::to_string(a) + "/distance");
+			for (size_t i = 0; file && i < online_nodes.size(); ++i) {
+				size_t d = 0;
+				if (file >> d) {
+					distances[a * nodes + online_nodes[i]] = d;
+				}
+			}
+		}
+	}
+
+	// Calls f for every number of lists like "0-3,8-11,16".
+	template <typename F> static void for_each_in_list(const std::string &list,
+													   F &&f)
+	{
+		const char *s = list.c_str();
+		while (*s) {
+			char *end = NULL;
+			long first = strtol(s, &end, 10);
+			if (end == s) {
+				break;
+			}
+			long last = first;
+			s = end;
+			if (*s == '-') {
+				++s;
+				last = strtol(s, &end, 10);
+				if (end == s) {
+					break;
+				}
+				s = end;
+			}
+			if (first >= 0 && last >= first) {
+				for (long i = first; i <= last; ++i) {
+					f((size_t)i);
+				}
+			}
+			if (*s == ',') {
+				++s;
+			} else {
+				break;
+			}
+		}
+	}
+
+	size_t nodes = 0;
+	std::vector<size_t> cpu_to_node;
+	// nodes x nodes matrix, 0 where unknown.
+	std::vector<size_t> distances;
+};
+
+const topology &get_topology()
+{
+	static topology t;
+	return t;
+}
+} // namespace
+
+size_t nodes_count() { return get_topology().nodes; }
+
+size_t node_of_cpu(int cpu)
+{
+	const topology &t = get_topology();
+	if (cpu < 0 || (size_t)cpu >= t.cpu_to_node.size()) {
+		return 0;
+	}
+	return t.cpu_to_node[cpu];
+}
+
+size_t distance(size_t a, size_t b)
+{
+	const topology &t = get_topology();
+	if (a < t.nodes && b < t.nodes && t.distances[a * t.nodes + b] > 0) {
+		return t.distances[a * t.nodes + b];
+	}
+	return a == b ? 10 : 20;
+}
+
+size_t current_node()
+{
+#if defined(__linux__)
+	return node_of_cpu(sched_getcpu());
+#else
+	return 0;
+#endif
+}
+
+bool pin_current_thread(int cpu)
+{
+#if defined(__linux__)
+	if (cpu < 0 || cpu >= CPU_SETSIZE) {
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+} // namespace numa
+} // namespace concurrent
+
+#endif
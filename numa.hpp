@@ -0,0 +1,38 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_NUMA_HPP
+#define CONCURRENT_NUMA_HPP
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace concurrent
+{
+namespace numa
+{
+// Number of NUMA nodes, discovered once from libnuma (when compiled with
+// CONCURRENT_USE_LIBNUMA) or /sys/devices/system/node. Highest node id + 1
+// when ids have gaps, always at least 1.
+size_t nodes_count();
+
+// Node of cpu, or 0 when topology is unknown.
+size_t node_of_cpu(int cpu);
+
+// Relative distance between nodes as reported by firmware (10 for local node,
+// larger is farther). Falls back to 10 for same and 20 for different nodes
+// when unknown.
+size_t distance(size_t a, size_t b);
+
+// Node of cpu on which calling thread currently runs, or 0 when unknown.
+size_t current_node();
+
+// Binds calling thread to cpu. Returns false when cpu is not available or
+// affinity is not supported on this platform.
+bool pin_current_thread(int cpu);
+} // namespace numa
+} // namespace concurrent
+
+#endif
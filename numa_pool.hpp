@@ -0,0 +1,125 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_NUMA_POOL_HPP
+#define CONCURRENT_NUMA_POOL_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "bucket_pool.hpp"
+#include "numa.hpp"
+
+namespace concurrent
+{
+//	One buckets_pool per NUMA node. Each node pool first serves buckets
+//	released on its own node, then steals from other nodes (nearest by
+//	numa::distance() first, ties in cyclic order of ids) and only then
+//	allocates from system. Requires linking numa.cpp.
+template<size_t BYTES>
+class numa_buckets_pool
+{
+public:
+	using pool_type = buckets_pool<BYTES>;
+	
+	numa_buckets_pool(size_t max_buckets_per_node)
+		: numa_buckets_pool(max_buckets_per_node, numa::nodes_count()) {}
+	
+	numa_buckets_pool(size_t max_buckets_per_node, size_t nodes) {
+		nodes_count = nodes > 0 ? nodes : 1;
+		pools = new pool_type*[nodes_count];
+		groups = new pool_type*[nodes_count * nodes_count];
+		for (size_t i=0; i<nodes_count; ++i) {
+			pools[i] = new pool_type(max_buckets_per_node);
+		}
+		for (size_t i=0; i<nodes_count; ++i) {
+			pool_type **group = groups + i*nodes_count;
+			size_t n = 0;
+			std::vector<size_t> order;
+			for (size_t d=1; d<nodes_count; ++d) {
+				order.push_back((i+d) % nodes_count);
+			}
+			std::stable_sort(order.begin(), order.end(), [i](size_t a, size_t b) {
+						return numa::distance(i, a) < numa::distance(i, b);
+					});
+			for (size_t node : order) {
+				group[n++] = pools[node];
+			}
+			pools[i]->set_steal_group(group, n);
+		}
+	}
+	
+	~numa_buckets_pool() {
+		for (size_t i=0; i<nodes_count; ++i) {
+			pools[i]->set_steal_group(NULL, 0);
+		}
+		for (size_t i=0; i<nodes_count; ++i) {
+			delete pools[i];
+		}
+		delete[] pools;
+		delete[] groups;
+		pools = NULL;
+		groups = NULL;
+	}
+	
+	numa_buckets_pool(const numa_buckets_pool &) = delete;
+	numa_buckets_pool &operator=(const numa_buckets_pool &) = delete;
+	
+	//	Pool of node on which calling thread runs. Intended use:
+	//		thread_local nonconcurrent::thread_local_pool<BYTES, N>
+	//			tls(numa_pool.local_pool());
+	pool_type *local_pool() {
+		return pools[numa::current_node() % nodes_count];
+	}
+	
+	pool_type *pool_for_node(size_t node) {
+		return pools[node % nodes_count];
+	}
+	
+	size_t count_nodes() const {
+		return nodes_count;
+	}
+	
+	uint64_t current_memory_resident() const {
+		uint64_t sum = 0;
+		for (size_t i=0; i<nodes_count; ++i) {
+			sum += pools[i]->current_memory_resident();
+		}
+		return sum;
+	}
+	
+	uint64_t count_bucket_steals() const {
+		uint64_t sum = 0;
+		for (size_t i=0; i<nodes_count; ++i) {
+			sum += pools[i]->count_bucket_steals();
+		}
+		return sum;
+	}
+	
+	uint64_t trim(uint64_t target_bytes_per_node, bool release_to_system = true) {
+		uint64_t sum = 0;
+		for (size_t i=0; i<nodes_count; ++i) {
+			sum += pools[i]->trim(target_bytes_per_node, false);
+		}
+		if (release_to_system) {
+			pool_type::release_free_memory_to_system();
+		}
+		return sum;
+	}
+	
+	void free_all() {
+		for (size_t i=0; i<nodes_count; ++i) {
+			pools[i]->free_all();
+		}
+	}
+	
+private:
+	pool_type **pools;
+	pool_type **groups;
+	size_t nodes_count;
+};
+}
+
+#endif
@@ -0,0 +1,273 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_OBJECT_POOL_HPP
+#define CONCURRENT_OBJECT_POOL_HPP
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <new>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+#include "bucket_pool.hpp"
+
+namespace concurrent
+{
+//	Size of pool block able to hold T, rounded up to malloc alignment.
+template<typename T>
+inline constexpr size_t pool_block_size() {
+	constexpr size_t a = alignof(std::max_align_t);
+	constexpr size_t s = sizeof(T) < sizeof(void*)*2 ? sizeof(void*)*2 : sizeof(T);
+	return (s + a - 1) / a * a;
+}
+
+//	Process wide buckets_pool of BYTES sized blocks with lazily created
+//	thread_local_pool in every thread using it. Global pool is never
+//	destroyed and blocks released after calling thread's local pool was
+//	destroyed (during thread exit) go directly to system, so blocks can be
+//	released from any thread at any time.
+template<size_t BYTES, size_t OBJECTS_PER_BUCKET = 256>
+class thread_cached_pool
+{
+public:
+	using local_pool_type = nonconcurrent::thread_local_pool<BYTES, OBJECTS_PER_BUCKET>;
+	using byte_array = typename local_pool_type::byte_array;
+	
+	static constexpr size_t DEFAULT_MAX_BUCKETS = 1024;
+	
+	static buckets_pool<BYTES> &global() {
+		static buckets_pool<BYTES> *pool =
+			new buckets_pool<BYTES>(DEFAULT_MAX_BUCKETS);
+		return *pool;
+	}
+	
+	//	NULL when called during or after destruction of thread locals.
+	static local_pool_type *local() {
+		if (tls_local != NULL) {
+			return tls_local;
+		}
+		if (tls_destroyed) {
+			return NULL;
+		}
+		static thread_local local_holder holder;
+		return tls_local;
+	}
+	
+	static void *allocate() {
+		local_pool_type *pool = local();
+		if (pool != NULL) {
+			return pool->template acquire<byte_array>();
+		}
+		return _internal_system_allocate();
+	}
+	
+	static void deallocate(void *ptr) {
+		if (ptr == NULL) {
+			return;
+		}
+		local_pool_type *pool = local();
+		if (pool != NULL) {
+			pool->template release<byte_array>((byte_array*)ptr);
+		} else {
+			_internal_system_free(ptr);
+		}
+	}
+	
+	//	Returns number of allocated blocks, which is always n.
+	static size_t allocate_n(void **out, size_t n) {
+		local_pool_type *pool = local();
+		if (pool != NULL) {
+			for (size_t i=0; i<n; ++i) {
+				out[i] = pool->template acquire<byte_array>();
+			}
+		} else {
+			for (size_t i=0; i<n; ++i) {
+				out[i] = _internal_system_allocate();
+			}
+		}
+		return n;
+	}
+	
+	//	NULL pointers are skipped.
+	static void deallocate_n(void *const *ptrs, size_t n) {
+		local_pool_type *pool = local();
+		for (size_t i=0; i<n; ++i) {
+			if (ptrs[i] == NULL) {
+			} else if (pool != NULL) {
+				pool->template release<byte_array>((byte_array*)ptrs[i]);
+			} else {
+				_internal_system_free(ptrs[i]);
+			}
+		}
+	}
+	
+private:
+	struct local_holder {
+		local_holder() : pool(&global()) {
+			tls_local = &pool;
+		}
+		~local_holder() {
+			tls_local = NULL;
+			tls_destroyed = true;
+		}
+		local_pool_type pool;
+	};
+	
+	static void *_internal_system_allocate() {
+		global().system_allocations_count++;
+		return malloc(BYTES);
+	}
+	
+	static void _internal_system_free(void *ptr) {
+		global().system_frees_count++;
+		free(ptr);
+	}
+	
+	inline static thread_local local_pool_type *tls_local = NULL;
+	inline static thread_local bool tls_destroyed = false;
+};
+
+//	std compatible allocator drawing single objects from thread_cached_pool,
+//	every rebound type uses pool of its own size. Arrays are allocated with
+//	operator new. Usable with std::allocate_shared.
+template<typename T, size_t OBJECTS_PER_BUCKET = 256>
+class pool_allocator
+{
+public:
+	using value_type = T;
+	using pool = thread_cached_pool<pool_block_size<T>(), OBJECTS_PER_BUCKET>;
+	
+	template<typename U>
+	struct rebind {
+		using other = pool_allocator<U, OBJECTS_PER_BUCKET>;
+	};
+	
+	pool_allocator() noexcept = default;
+	template<typename U>
+	pool_allocator(const pool_allocator<U, OBJECTS_PER_BUCKET> &) noexcept {}
+	
+	T *allocate(size_t n) {
+		if (n == 1 && alignof(T) <= alignof(std::max_align_t)) {
+			return (T*)pool::allocate();
+		}
+		return std::allocator<T>().allocate(n);
+	}
+	
+	void deallocate(T *ptr, size_t n) noexcept {
+		if (n == 1 && alignof(T) <= alignof(std::max_align_t)) {
+			pool::deallocate(ptr);
+		} else {
+			std::allocator<T>().deallocate(ptr, n);
+		}
+	}
+	
+	template<typename U>
+	bool operator==(const pool_allocator<U, OBJECTS_PER_BUCKET> &) const noexcept {
+		return true;
+	}
+	template<typename U>
+	bool operator!=(const pool_allocator<U, OBJECTS_PER_BUCKET> &) const noexcept {
+		return false;
+	}
+};
+
+//	Typed facade over thread_cached_pool. Objects may be released from
+//	any thread, handles release them automatically.
+template<typename T, size_t OBJECTS_PER_BUCKET = 256>
+class object_pool
+{
+public:
+	static_assert(alignof(T) <= alignof(std::max_align_t),
+			"object_pool does not support over aligned types");
+	
+	static constexpr size_t BYTES = pool_block_size<T>();
+	using pool = thread_cached_pool<BYTES, OBJECTS_PER_BUCKET>;
+	
+	struct deleter {
+		void operator()(T *ptr) const {
+			object_pool::release(ptr);
+		}
+	};
+	
+	using handle = std::unique_ptr<T, deleter>;
+	
+	template<typename U>
+	using allocator = pool_allocator<U, OBJECTS_PER_BUCKET>;
+	
+	template<typename... Args>
+	static T *acquire_raw(Args&&... args) {
+		void *ptr = pool::allocate();
+		if constexpr (std::is_nothrow_constructible_v<T, Args&&...>) {
+			return new(ptr) T(std::forward<Args>(args)...);
+		} else {
+			try {
+				return new(ptr) T(std::forward<Args>(args)...);
+			} catch (...) {
+				pool::deallocate(ptr);
+				throw;
+			}
+		}
+	}
+	
+	template<typename... Args>
+	static handle acquire(Args&&... args) {
+		return handle(acquire_raw(std::forward<Args>(args)...));
+	}
+	
+	static void release(T *ptr) {
+		if (ptr != NULL) {
+			ptr->~T();
+			pool::deallocate(ptr);
+		}
+	}
+	
+	//	Every object is copy constructed from the same args.
+	template<typename... Args>
+	static void acquire_n(T **out, size_t n, const Args&... args) {
+		pool::allocate_n((void**)out, n);
+		size_t i = 0;
+		try {
+			for (; i<n; ++i) {
+				new((void*)out[i]) T(args...);
+			}
+		} catch (...) {
+			release_n(out, i);
+			pool::deallocate_n((void**)out + i, n - i);
+			throw;
+		}
+	}
+	
+	template<typename... Args>
+	static void acquire_n(handle *out, size_t n, const Args&... args) {
+		for (size_t i=0; i<n; ++i) {
+			out[i] = acquire(args...);
+		}
+	}
+	
+	static void release_n(T *const *ptrs, size_t n) {
+		for (size_t i=0; i<n; ++i) {
+			if (ptrs[i] != NULL) {
+				ptrs[i]->~T();
+			}
+		}
+		pool::deallocate_n((void *const *)ptrs, n);
+	}
+	
+	static void release_n(handle *handles, size_t n) {
+		for (size_t i=0; i<n; ++i) {
+			handles[i].reset();
+		}
+	}
+	
+	static buckets_pool<BYTES> &global() {
+		return pool::global();
+	}
+};
+}
+
+#endif
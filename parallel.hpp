@@ -0,0 +1,373 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_PARALLEL_HPP
+#define CONCURRENT_PARALLEL_HPP
+
+#include <cstdlib>
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "executor.hpp"
+#include "future.hpp"
+#include "object_pool.hpp"
+
+//	Parallel algorithms over random access ranges, run on executor and never
+//	blocking calling thread. Range is split into chunks of grain elements
+//	(by default about 8 chunks per worker), chunks are spawned by recursive
+//	halving so idle workers steal large halves first. Ranges and functions
+//	must stay valid until returned future is finished. Exception thrown by
+//	func, op or comp finishes returned future with error, chunks not started
+//	yet are skipped and range is left partially processed.
+
+namespace concurrent
+{
+namespace parallel_detail
+{
+inline size_t auto_grain(executor &ex, size_t n, size_t grain, size_t min_grain = 1) {
+	if (grain == 0) {
+		grain = n / (ex.count_workers() * 8);
+	}
+	return grain < min_grain ? min_grain : grain;
+}
+
+inline size_t count_chunks(size_t n, size_t grain) {
+	return (n + grain - 1) / grain;
+}
+
+//	Runs body(chunk) for every chunk in [0, chunks), then done(ok) on thread
+//	which finished last chunk. After body throws, remaining chunks are
+//	skipped and ok is false.
+template<typename Body, typename Done>
+class chunk_job {
+public:
+	using pool = object_pool<chunk_job<Body, Done>>;
+	
+	template<typename B, typename D>
+	chunk_job(executor &ex, size_t chunks, B &&body, D &&done)
+		: ex(ex), remaining(chunks), body(std::forward<B>(body)),
+		done(std::forward<D>(done)) {}
+	
+	void split(size_t begin, size_t end) {
+		while (end - begin > 1) {
+			size_t mid = begin + (end - begin) / 2;
+			ex.execute([this, mid, end]() { split(mid, end); });
+			end = mid;
+		}
+		if (failed.load(std::memory_order_relaxed) == false) {
+			try {
+				body(begin);
+			} catch (...) {
+				failed.store(true, std::memory_order_relaxed);
+			}
+		}
+		if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			Done d = std::move(done);
+			const bool ok = failed.load(std::memory_order_relaxed) == false;
+			pool::release(this);
+			d(ok);
+		}
+	}
+	
+private:
+	executor &ex;
+	std::atomic<size_t> remaining;
+	std::atomic<bool> failed = false;
+	Body body;
+	Done done;
+};
+
+template<typename Body, typename Done>
+void for_each_chunk(executor &ex, size_t chunks, Body &&body, Done &&done) {
+	using job = chunk_job<std::decay_t<Body>, std::decay_t<Done>>;
+	if (chunks == 0) {
+		done(true);
+		return;
+	}
+	job *j = job::pool::acquire_raw(ex, chunks, std::forward<Body>(body),
+			std::forward<Done>(done));
+	ex.execute([j, chunks]() { j->split(0, chunks); });
+}
+
+//	Number of elements taken from a in first k elements of stable merge of
+//	a[0, m) and b[0, n).
+template<typename A, typename B, typename Comp>
+size_t merge_co_rank(size_t k, A a, size_t m, B b, size_t n, Comp &comp) {
+	size_t lo = k > n ? k - n : 0;
+	size_t hi = k < m ? k : m;
+	while (lo < hi) {
+		size_t i = lo + (hi - lo) / 2;
+		if (!comp(b[k - i - 1], a[i])) {
+			lo = i + 1;
+		} else {
+			hi = i;
+		}
+	}
+	return lo;
+}
+
+//	Merges part-th of parts slices of output of merging src[lo, mid) with
+//	src[mid, hi) into dst[lo, hi).
+template<typename Src, typename Dst, typename Comp>
+void merge_part(Src src, Dst dst, size_t lo, size_t mid, size_t hi,
+		size_t part, size_t parts, Comp &comp) {
+	size_t m = mid - lo, n = hi - mid, len = hi - lo;
+	size_t k0 = len * part / parts;
+	size_t k1 = len * (part + 1) / parts;
+	size_t i0 = merge_co_rank(k0, src + lo, m, src + mid, n, comp);
+	size_t i1 = merge_co_rank(k1, src + lo, m, src + mid, n, comp);
+	size_t j0 = k0 - i0, j1 = k1 - i1;
+	std::merge(std::make_move_iterator(src + lo + i0),
+			std::make_move_iterator(src + lo + i1),
+			std::make_move_iterator(src + mid + j0),
+			std::make_move_iterator(src + mid + j1), dst + lo + k0, comp);
+}
+
+template<typename It, typename Comp>
+class sort_job {
+public:
+	using value_type = typename std::iterator_traits<It>::value_type;
+	
+	sort_job(executor &ex, It first, size_t n, Comp comp, size_t grain,
+			promise<bool> &&p)
+		: ex(ex), first(first), n(n), comp(std::move(comp)), grain(grain),
+		buffer(n), p(std::move(p)) {}
+	
+	void start() {
+		for_each_chunk(ex, count_chunks(n, grain), [this](size_t c) {
+					size_t b = c * grain;
+					size_t e = std::min(b + grain, n);
+					std::stable_sort(first + b, first + e, comp);
+				}, [this](bool ok) {
+					if (ok) {
+						merge_level(grain, true);
+					} else {
+						finish(false);
+					}
+				});
+	}
+	
+private:
+	//	Merges pairs of sorted runs of width from data into buffer or the
+	//	other way, big merges are split into parts so all workers get work.
+	void merge_level(size_t width, bool src_is_data) {
+		if (width >= n) {
+			if (src_is_data) {
+				finish(true);
+			} else {
+				for_each_chunk(ex, count_chunks(n, grain), [this](size_t c) {
+							size_t b = c * grain;
+							size_t e = std::min(b + grain, n);
+							std::move(buffer.begin() + b, buffer.begin() + e, first + b);
+						}, [this](bool ok) { finish(ok); });
+			}
+			return;
+		}
+		size_t pairs = count_chunks(n, width * 2);
+		size_t parts = std::max<size_t>(1, ex.count_workers() * 4 / pairs);
+		parts = std::min(parts, std::max<size_t>(1, width * 2 / grain));
+		for_each_chunk(ex, pairs * parts, [this, width, parts, src_is_data](size_t t) {
+					size_t lo = (t / parts) * width * 2;
+					size_t mid = std::min(lo + width, n);
+					size_t hi = std::min(lo + width * 2, n);
+					if (src_is_data) {
+						merge_part(first, buffer.begin(), lo, mid, hi, t % parts, parts, comp);
+					} else {
+						merge_part(buffer.begin(), first, lo, mid, hi, t % parts, parts, comp);
+					}
+				}, [this, width, src_is_data](bool ok) {
+					if (ok) {
+						merge_level(width * 2, !src_is_data);
+					} else {
+						finish(false);
+					}
+				});
+	}
+	
+	void finish(bool ok) {
+		promise<bool> pr = std::move(p);
+		delete this;
+		if (ok) {
+			pr.set_value(true);
+		} else {
+			pr.set_error();
+		}
+	}
+	
+	executor &ex;
+	It first;
+	size_t n;
+	Comp comp;
+	size_t grain;
+	std::vector<value_type> buffer;
+	promise<bool> p;
+};
+}
+
+//	Calls func(i) for every i in [begin, end).
+template<typename F>
+future<bool> parallel_for(executor &ex, size_t begin, size_t end, F &&func,
+		size_t grain = 0) {
+	promise<bool> p;
+	future<bool> ret = p.get_future();
+	size_t n = end > begin ? end - begin : 0;
+	grain = parallel_detail::auto_grain(ex, n, grain);
+	parallel_detail::for_each_chunk(ex, parallel_detail::count_chunks(n, grain),
+			[begin, end, grain, func = std::forward<F>(func)](size_t c) {
+				size_t b = begin + c * grain;
+				size_t e = std::min(b + grain, end);
+				for (size_t i=b; i<e; ++i) {
+					func(i);
+				}
+			}, [p = std::move(p)](bool ok) mutable {
+				if (ok) {
+					p.set_value(true);
+				} else {
+					p.set_error();
+				}
+			});
+	return ret;
+}
+
+//	Calls func(element) for every element of [first, last).
+template<typename It, typename F>
+future<bool> parallel_for_each(executor &ex, It first, It last, F &&func,
+		size_t grain = 0) {
+	return parallel_for(ex, 0, last - first,
+			[first, func = std::forward<F>(func)](size_t i) { func(first[i]); },
+			grain);
+}
+
+//	Folds init with all elements using associative op, partial results of
+//	chunks are combined in order, so op need not be commutative.
+template<typename It, typename T, typename Op>
+future<T> parallel_reduce(executor &ex, It first, It last, T init, Op op,
+		size_t grain = 0) {
+	promise<T> p;
+	future<T> ret = p.get_future();
+	size_t n = last - first;
+	grain = parallel_detail::auto_grain(ex, n, grain);
+	size_t chunks = parallel_detail::count_chunks(n, grain);
+	std::vector<T> *partials = new std::vector<T>(chunks, init);
+	T *out = partials->data();
+	parallel_detail::for_each_chunk(ex, chunks,
+			[first, n, grain, out, op](size_t c) {
+				size_t b = c * grain;
+				size_t e = std::min(b + grain, n);
+				T acc = first[b];
+				for (size_t i=b+1; i<e; ++i) {
+					acc = op(std::move(acc), first[i]);
+				}
+				out[c] = std::move(acc);
+			}, [p = std::move(p), partials, init = std::move(init), op](bool ok) mutable {
+				try {
+					if (ok) {
+						T acc = std::move(init);
+						for (T &v : *partials) {
+							acc = op(std::move(acc), std::move(v));
+						}
+						delete partials;
+						p.set_value(std::move(acc));
+						return;
+					}
+				} catch (...) {
+				}
+				delete partials;
+				p.set_error();
+			});
+	return ret;
+}
+
+//	Inclusive scan of [first, last) into out with associative op, in two
+//	passes: chunk totals, then chunk scans offset by prefix of totals. out
+//	may be equal to first.
+template<typename InIt, typename OutIt, typename Op>
+future<bool> parallel_scan(executor &ex, InIt first, InIt last, OutIt out,
+		Op op, size_t grain = 0) {
+	using T = typename std::iterator_traits<InIt>::value_type;
+	promise<bool> p;
+	future<bool> ret = p.get_future();
+	size_t n = last - first;
+	if (n == 0) {
+		p.set_value(true);
+		return ret;
+	}
+	grain = parallel_detail::auto_grain(ex, n, grain);
+	size_t chunks = parallel_detail::count_chunks(n, grain);
+	std::vector<T> *totals = new std::vector<T>(chunks, first[0]);
+	T *sums = totals->data();
+	executor *exp = &ex;
+	parallel_detail::for_each_chunk(ex, chunks,
+			[first, n, grain, sums, op](size_t c) {
+				size_t b = c * grain;
+				size_t e = std::min(b + grain, n);
+				T acc = first[b];
+				for (size_t i=b+1; i<e; ++i) {
+					acc = op(std::move(acc), first[i]);
+				}
+				sums[c] = std::move(acc);
+			}, [p = std::move(p), totals, sums, chunks, exp, first, out, n, grain, op](bool ok) mutable {
+				try {
+					for (size_t c=1; ok && c<chunks; ++c) {
+						sums[c] = op(sums[c-1], sums[c]);
+					}
+				} catch (...) {
+					ok = false;
+				}
+				if (ok == false) {
+					delete totals;
+					p.set_error();
+					return;
+				}
+				parallel_detail::for_each_chunk(*exp, chunks,
+						[first, out, n, grain, sums, op](size_t c) {
+							size_t b = c * grain;
+							size_t e = std::min(b + grain, n);
+							T acc = c == 0 ? T(first[b]) : op(sums[c-1], first[b]);
+							out[b] = acc;
+							for (size_t i=b+1; i<e; ++i) {
+								acc = op(std::move(acc), first[i]);
+								out[i] = acc;
+							}
+						}, [p = std::move(p), totals](bool ok) mutable {
+							delete totals;
+							if (ok) {
+								p.set_value(true);
+							} else {
+								p.set_error();
+							}
+						});
+			});
+	return ret;
+}
+
+//	Stable merge sort: chunks are sorted with std::stable_sort, then merged
+//	level by level through buffer of n elements, taking from left run on
+//	ties.
+template<typename It, typename Comp = std::less<>>
+future<bool> parallel_sort(executor &ex, It first, It last, Comp comp = Comp(),
+		size_t grain = 0) {
+	promise<bool> p;
+	future<bool> ret = p.get_future();
+	size_t n = last - first;
+	if (n < 2) {
+		p.set_value(true);
+		return ret;
+	}
+	grain = parallel_detail::auto_grain(ex, n, grain, 1024);
+	auto *job = new parallel_detail::sort_job<It, Comp>(ex, first, n,
+			std::move(comp), grain, std::move(p));
+	job->start();
+	return ret;
+}
+}
+
+#endif
@@ -0,0 +1,324 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_PIPELINE_HPP
+#define CONCURRENT_PIPELINE_HPP
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "spsc_ringbuffer.hpp"
+#include "backoff.hpp"
+#include "numa.hpp"
+#include "time.hpp"
+
+namespace concurrent
+{
+//	Connects two stages of pipeline, exactly one writes and one reads it.
+//	Closed by writing stage when it finishes, reading stage finishes after
+//	draining closed channel.
+template<typename T, size_t SIZE = 1024>
+class channel
+{
+public:
+	spsc::ringbuffer<T, SIZE> ring;
+
+	inline void close() {
+		closed.store(true, std::memory_order_release);
+	}
+
+	//	Writer closed channel and everything it pushed was popped.
+	inline bool is_finished() const {
+		return closed.load(std::memory_order_acquire) && ring.is_empty();
+	}
+
+private:
+	std::atomic<bool> closed = false;
+};
+
+//	Snapshot of counters of one stage. Bottleneck is the first stage whose
+//	input is (nearly) full while its output is not: stages before it wait on
+//	full output (backpressure), stages after it wait on empty input.
+struct stage_stats {
+	std::string name;
+	uint64_t items_in = 0;
+	uint64_t items_out = 0;
+	uint64_t batches = 0;
+	//	Passes that found input empty, 0 for sources.
+	uint64_t input_waits = 0;
+	//	Passes that found output full, 0 for sinks.
+	uint64_t output_waits = 0;
+	//	Values waiting in input channel, 0 for sources.
+	size_t queue_depth = 0;
+	size_t queue_capacity = 0;
+	//	Since start(), items_in (items_out for sources) per second.
+	double throughput = 0;
+};
+
+//	Stages connected by channels (spsc::ringbuffer), each running in own
+//	thread, optionally pinned to cpu. Stages move up to batch values per
+//	pass with single index store per ring. Stage with full output stops
+//	consuming input, so backpressure propagates up to sources. Idle stages
+//	spin briefly and then yield, they never sleep. Pinning requires linking
+//	numa.cpp.
+//
+//	Stages are added before start(), stop() makes sources finish, after
+//	which the rest drain their input and finish. join() waits for all.
+class pipeline
+{
+public:
+	static constexpr size_t DEFAULT_BATCH = 64;
+
+	pipeline(size_t batch = DEFAULT_BATCH) : batch(batch ? batch : 1) {}
+	//	Stops and joins.
+	~pipeline() {
+		stop();
+		join();
+	}
+
+	pipeline(const pipeline &) = delete;
+	pipeline(pipeline &&) = delete;
+	pipeline &operator=(const pipeline &) = delete;
+	pipeline &operator=(pipeline &&) = delete;
+
+	//	bool produce(Out &value) fills next value, returns false when source
+	//	is exhausted (value is then discarded).
+	template<typename Out, size_t OUT_SIZE, typename F>
+	void add_source(std::string name, F &&produce,
+			channel<Out, OUT_SIZE> &out, int cpu = -1) {
+		stage *s = _internal_add_stage(std::move(name), cpu, NULL, 0);
+		s->body = [this, s, produce = std::forward<F>(produce), &out]() mutable {
+			_internal_run_source(*s, produce, out);
+		};
+	}
+
+	//	bool transform(In &in, Out &out) fills out from in, returns false
+	//	to drop in without output.
+	template<typename In, size_t IN_SIZE, typename Out, size_t OUT_SIZE,
+			typename F>
+	void add_stage(std::string name, channel<In, IN_SIZE> &in,
+			F &&transform, channel<Out, OUT_SIZE> &out, int cpu = -1) {
+		stage *s = _internal_add_stage(std::move(name), cpu,
+				[&in]() { return in.ring.count(); }, IN_SIZE);
+		s->body = [this, s, transform = std::forward<F>(transform), &in,
+				&out]() mutable {
+			_internal_run_stage(*s, in, transform, out);
+		};
+	}
+
+	//	void consume(In &value)
+	template<typename In, size_t IN_SIZE, typename F>
+	void add_sink(std::string name, channel<In, IN_SIZE> &in, F &&consume,
+			int cpu = -1) {
+		stage *s = _internal_add_stage(std::move(name), cpu,
+				[&in]() { return in.ring.count(); }, IN_SIZE);
+		s->body = [this, s, consume = std::forward<F>(consume), &in]() mutable {
+			_internal_run_sink(*s, in, consume);
+		};
+	}
+
+	void start() {
+		started_ns.store(time::now().ns, std::memory_order_relaxed);
+		for (std::unique_ptr<stage> &s : stages) {
+			s->thread = std::thread([s = s.get()]() {
+				if (s->cpu >= 0) {
+					numa::pin_current_thread(s->cpu);
+				}
+				s->body();
+				s->finished.store(true, std::memory_order_release);
+			});
+		}
+	}
+
+	//	Sources finish after current batch, other stages after draining.
+	void stop() {
+		stopping.store(true, std::memory_order_relaxed);
+	}
+
+	void join() {
+		for (std::unique_ptr<stage> &s : stages) {
+			if (s->thread.joinable()) {
+				s->thread.join();
+			}
+		}
+	}
+
+	//	Whether all stages finished, join() will not block.
+	bool is_finished() const {
+		for (const std::unique_ptr<stage> &s : stages) {
+			if (s->finished.load(std::memory_order_acquire) == false) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//	Safe to call from any thread while running, in order of adding.
+	std::vector<stage_stats> stats() const {
+		//	0 before start(), throughput is then reported as 0.
+		const int64_t started = started_ns.load(std::memory_order_relaxed);
+		const double sec =
+			started ? (time::now() - time::point{started}).sec() : 0;
+		std::vector<stage_stats> ret;
+		for (const std::unique_ptr<stage> &s : stages) {
+			stage_stats st;
+			st.name = s->name;
+			st.items_in = s->items_in.load(std::memory_order_relaxed);
+			st.items_out = s->items_out.load(std::memory_order_relaxed);
+			st.batches = s->batches.load(std::memory_order_relaxed);
+			st.input_waits = s->input_waits.load(std::memory_order_relaxed);
+			st.output_waits = s->output_waits.load(std::memory_order_relaxed);
+			st.queue_depth = s->depth ? s->depth() : 0;
+			st.queue_capacity = s->capacity;
+			const uint64_t items = s->depth ? st.items_in : st.items_out;
+			st.throughput = sec > 0 ? items / sec : 0;
+			ret.push_back(std::move(st));
+		}
+		return ret;
+	}
+
+private:
+	//	Counters are written only by stage thread.
+	struct alignas(64) stage {
+		std::atomic<uint64_t> items_in = 0;
+		std::atomic<uint64_t> items_out = 0;
+		std::atomic<uint64_t> batches = 0;
+		std::atomic<uint64_t> input_waits = 0;
+		std::atomic<uint64_t> output_waits = 0;
+		std::atomic<bool> finished = false;
+
+		std::string name;
+		int cpu;
+		std::function<size_t()> depth;
+		size_t capacity;
+		std::function<void()> body;
+		std::thread thread;
+
+		inline void add(std::atomic<uint64_t> &counter, uint64_t n) {
+			counter.store(counter.load(std::memory_order_relaxed) + n,
+					std::memory_order_relaxed);
+		}
+	};
+
+	stage *_internal_add_stage(std::string name, int cpu,
+			std::function<size_t()> depth, size_t capacity) {
+		stages.push_back(std::make_unique<stage>());
+		stage *s = stages.back().get();
+		s->name = std::move(name);
+		s->cpu = cpu;
+		s->depth = std::move(depth);
+		s->capacity = capacity;
+		return s;
+	}
+
+	template<typename Out, size_t OUT_SIZE, typename F>
+	void _internal_run_source(stage &s, F &produce,
+			channel<Out, OUT_SIZE> &out) {
+		spin_then_yield_backoff backoff;
+		bool exhausted = false;
+		while (exhausted == false &&
+				stopping.load(std::memory_order_relaxed) == false) {
+			const size_t n = std::min(out.ring.count_free(), batch);
+			if (n == 0) {
+				s.add(s.output_waits, 1);
+				backoff.pause();
+				continue;
+			}
+			backoff.reset();
+			size_t produced = 0;
+			while (produced < n) {
+				if (produce(out.ring.head(produced)) == false) {
+					exhausted = true;
+					break;
+				}
+				++produced;
+			}
+			out.ring.push_n(produced);
+			s.add(s.items_out, produced);
+			s.add(s.batches, 1);
+		}
+		out.close();
+	}
+
+	template<typename In, size_t IN_SIZE, typename Out, size_t OUT_SIZE,
+			typename F>
+	void _internal_run_stage(stage &s, channel<In, IN_SIZE> &in,
+			F &transform, channel<Out, OUT_SIZE> &out) {
+		spin_then_yield_backoff backoff;
+		for (;;) {
+			size_t n = in.ring.count();
+			if (n == 0) {
+				if (in.is_finished()) {
+					break;
+				}
+				s.add(s.input_waits, 1);
+				backoff.pause();
+				continue;
+			}
+			const size_t free = out.ring.count_free();
+			if (free == 0) {
+				s.add(s.output_waits, 1);
+				backoff.pause();
+				continue;
+			}
+			backoff.reset();
+			n = std::min({n, free, batch});
+			size_t produced = 0;
+			for (size_t i = 0; i < n; ++i) {
+				if (transform(in.ring.tail(i), out.ring.head(produced))) {
+					++produced;
+				}
+			}
+			out.ring.push_n(produced);
+			in.ring.pop_n(n);
+			s.add(s.items_in, n);
+			s.add(s.items_out, produced);
+			s.add(s.batches, 1);
+		}
+		out.close();
+	}
+
+	template<typename In, size_t IN_SIZE, typename F>
+	void _internal_run_sink(stage &s, channel<In, IN_SIZE> &in, F &consume) {
+		spin_then_yield_backoff backoff;
+		for (;;) {
+			size_t n = in.ring.count();
+			if (n == 0) {
+				if (in.is_finished()) {
+					break;
+				}
+				s.add(s.input_waits, 1);
+				backoff.pause();
+				continue;
+			}
+			backoff.reset();
+			n = std::min(n, batch);
+			for (size_t i = 0; i < n; ++i) {
+				consume(in.ring.tail(i));
+			}
+			in.ring.pop_n(n);
+			s.add(s.items_in, n);
+			s.add(s.batches, 1);
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<stage>> stages;
+	std::atomic<bool> stopping = false;
+	std::atomic<int64_t> started_ns = 0;
+	const size_t batch;
+};
+}
+
+#endif
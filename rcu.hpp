@@ -0,0 +1,150 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_RCU_HPP
+#define CONCURRENT_RCU_HPP
+
+#include <cstdint>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace concurrent
+{
+//	Epoch based read-copy-update domain shared by whole process. Readers
+//	enter critical section with read_guard, which stores current epoch into
+//	cache line owned by calling thread and issues one fence, so readers never
+//	write shared memory. Writer publishes new version of data, calls
+//	retire_epoch() and frees old version once is_quiescent() for returned
+//	epoch, which happens when every reader that could have seen old version
+//	left its critical section.
+namespace rcu
+{
+namespace detail
+{
+struct alignas(64) reader {
+	//	Epoch observed when outermost read_guard was entered, 0 when
+	//	outside of critical section.
+	std::atomic<uint64_t> epoch = 0;
+	//	Touched only by owning thread.
+	uint32_t nesting = 0;
+	std::atomic<bool> in_use = false;
+};
+
+struct registry {
+	std::mutex mutex;
+	std::vector<reader *> readers;
+};
+
+inline registry &get_registry() {
+	// Leaked, threads may exit after static destructors ran.
+	static registry *r = new registry();
+	return *r;
+}
+
+inline std::atomic<uint64_t> global_epoch = 1;
+
+//	Reader records are reused by threads created later, so their count is
+//	bounded by maximum number of simultaneously live reading threads.
+struct reader_owner {
+	reader *r = NULL;
+
+	~reader_owner() {
+		if (r != NULL) {
+			r->in_use.store(false, std::memory_order_release);
+			r = NULL;
+		}
+	}
+};
+
+inline thread_local reader_owner local_reader;
+
+inline reader *_internal_register_thread() {
+	registry &reg = get_registry();
+	std::lock_guard lock(reg.mutex);
+	reader *r = NULL;
+	for (reader *it : reg.readers) {
+		if (it->in_use.load(std::memory_order_acquire) == false) {
+			r = it;
+			break;
+		}
+	}
+	if (r == NULL) {
+		r = new reader();
+		reg.readers.push_back(r);
+	}
+	r->in_use.store(true, std::memory_order_relaxed);
+	local_reader.r = r;
+	return r;
+}
+} // namespace detail
+
+//	Read-side critical section, may be nested. Data published under RCU
+//	and read inside it is not freed until the outermost guard is destroyed.
+class read_guard
+{
+public:
+	read_guard() {
+		r = detail::local_reader.r;
+		if (r == NULL) {
+			r = detail::_internal_register_thread();
+		}
+		if (r->nesting++ == 0) {
+			// Pairs with fence in retire_epoch(): either writer sees this
+			// epoch, or loads done after the fence see its new version.
+			r->epoch.store(
+					detail::global_epoch.load(std::memory_order_acquire),
+					std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+	}
+	~read_guard() {
+		if (--r->nesting == 0) {
+			r->epoch.store(0, std::memory_order_release);
+		}
+	}
+
+	read_guard(const read_guard &) = delete;
+	read_guard &operator=(const read_guard &) = delete;
+
+private:
+	detail::reader *r;
+};
+
+//	Call after unpublishing old version (storing new pointer), returns
+//	epoch to pass to is_quiescent().
+inline uint64_t retire_epoch() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	return detail::global_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+}
+
+//	Whether all critical sections which could observe data retired with
+//	epoch have finished. Never blocks on readers, takes registry mutex.
+inline bool is_quiescent(uint64_t epoch) {
+	detail::registry &reg = detail::get_registry();
+	std::lock_guard lock(reg.mutex);
+	for (detail::reader *r : reg.readers) {
+		const uint64_t e = r->epoch.load(std::memory_order_acquire);
+		if (e != 0 && e < epoch) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//	Waits until all critical sections that began before the call have
+//	finished. Must not be called inside read_guard.
+inline void synchronize() {
+	const uint64_t epoch = retire_epoch();
+	while (is_quiescent(epoch) == false) {
+		std::this_thread::yield();
+	}
+}
+} // namespace rcu
+}
+
+#endif
@@ -0,0 +1,148 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_RUN_LOOP_HPP
+#define CONCURRENT_RUN_LOOP_HPP
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "mpsc_queue.hpp"
+#include "futex.hpp"
+#include "future.hpp"
+#include "work_item.hpp"
+
+namespace concurrent
+{
+//	Single consumer executor: any thread may execute() functions, they are
+//	run in order by thread calling run(), run_one() or run_until(). Work
+//	items are allocated from object_pool and idle consumer sleeps on futex.
+class run_loop
+{
+public:
+	run_loop() = default;
+	~run_loop() {
+		for (;;) {
+			work_item *item = queue.pop();
+			if (item == NULL) {
+				break;
+			}
+			item->discard();
+		}
+	}
+	
+	run_loop(const run_loop &) = delete;
+	run_loop(run_loop &&) = delete;
+	run_loop &operator=(const run_loop &) = delete;
+	run_loop &operator=(run_loop &&) = delete;
+	
+	//	Safe to call from any thread.
+	template<typename F>
+	void execute(F &&func) {
+		queue.push(work_item::create(std::forward<F>(func)));
+		_internal_notify();
+	}
+	
+	//	Following functions may be called only by single consumer thread.
+	
+	bool run_one() {
+		work_item *item = queue.pop();
+		if (item == NULL) {
+			return false;
+		}
+		item->run();
+		return true;
+	}
+	
+	//	Runs everything already queued, returns number of run items.
+	size_t run_pending() {
+		size_t count = 0;
+		while (run_one()) {
+			++count;
+		}
+		return count;
+	}
+	
+	//	Runs items until stop() is called, sleeping when queue is empty.
+	void run() {
+		while (stopped.load(std::memory_order_acquire) == false) {
+			if (run_one() == false) {
+				_internal_sleep([this]() {
+							return stopped.load(std::memory_order_acquire);
+						});
+			}
+		}
+		stopped.store(false, std::memory_order_relaxed);
+	}
+	
+	//	Runs items until f is finished, then returns f.get(). Aborts on
+	//	future without state, same as future::get(), as it would never
+	//	finish.
+	template<typename T>
+	T &run_until(future<T> &f) {
+		if (f.has_any_state() == false) {
+			abort();
+		}
+		std::atomic<bool> notified = false;
+		f.on_finish([this, &notified](future<T> &) {
+					_internal_notify();
+					notified.store(true, std::memory_order_release);
+				});
+		while (f.finished() == false) {
+			if (run_one() == false) {
+				_internal_sleep([&f]() {
+							return f.finished();
+						});
+			}
+		}
+		run_pending();
+		// Continuation runs after f becomes finished, possibly on other
+		// thread, and must not touch this loop after it is destroyed.
+		while (notified.load(std::memory_order_acquire) == false) {
+			std::this_thread::yield();
+		}
+		return f.get();
+	}
+	
+	//	Safe to call from any thread, makes run() return.
+	void stop() {
+		stopped.store(true, std::memory_order_release);
+		_internal_notify();
+	}
+	
+private:
+	//	Lowest bit of signal marks sleeping consumer, every notify changes
+	//	value so consumer never misses it.
+	void _internal_notify() {
+		if (signal.fetch_add(2) & 1) {
+			signal.fetch_and(~(uint32_t)1);
+			futex::wake_one(&signal);
+		}
+	}
+	
+	template<typename F>
+	void _internal_sleep(F &&should_wake) {
+		uint32_t v = signal.load();
+		if (signal.compare_exchange_strong(v, v | 1) == false) {
+			return;
+		}
+		if (queue.empty() && should_wake() == false) {
+			futex::wait(&signal, v | 1);
+		}
+		signal.fetch_and(~(uint32_t)1);
+	}
+	
+private:
+	mpsc::queue<work_item> queue;
+	std::atomic<uint32_t> signal = 0;
+	std::atomic<bool> stopped = false;
+};
+}
+
+#endif
@@ -0,0 +1,161 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_SPMC_DEQUE_HPP
+#define CONCURRENT_SPMC_DEQUE_HPP
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <new>
+#include <atomic>
+#include <bit>
+
+namespace concurrent {
+	namespace spmc {
+		// Chase-Lev work stealing deque of pointers (after Le, Pop, Cohen,
+		// Zappa Nardelli 2013, with seq_cst operations in place of their
+		// fences). Owner thread push()es and pop()s
+		// at bottom (LIFO), any thread may steal() from top (FIFO). Grows on
+		// demand, old arrays are kept until destruction because concurrent
+		// stealers may still read them.
+		template<typename T>
+		class deque {
+		public:
+			
+			deque(size_t initial_capacity = 256) : _top(0), _bottom(0) {
+				size_t cap = std::bit_ceil(initial_capacity < 2 ? 2 : initial_capacity);
+				_array = array::create(cap, NULL);
+			}
+			deque(deque&&) = delete;
+			deque(const deque&) = delete;
+			~deque() {
+				array *a = _array.load(std::memory_order_relaxed);
+				while(a) {
+					array *prev = a->previous;
+					free(a);
+					a = prev;
+				}
+			}
+			
+			deque& operator=(deque&&) = delete;
+			deque& operator=(const deque&) = delete;
+			
+			// Owner only.
+			inline void push(T* value) {
+				int64_t b = _bottom.load(std::memory_order_relaxed);
+				int64_t t = _top.load(std::memory_order_acquire);
+				array *a = _array.load(std::memory_order_relaxed);
+				if(b - t > (int64_t)a->mask) {
+					a = grow(a, t, b);
+				}
+				a->put(b, value);
+				_bottom.store(b+1, std::memory_order_release);
+			}
+			
+			// Owner only, returns NULL when empty.
+			//
+			// Store of bottom and load of top here and the two loads in
+			// steal() are seq_cst operations instead of relaxed ones
+			// separated by fences, so at least one side sees the other when
+			// they race for the last value. Same cost on x86 and visible to
+			// ThreadSanitizer, which does not model fences. Restoring bottom
+			// is release, so thieves reading it still see pushed values.
+			inline T* pop() {
+				int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+				array *a = _array.load(std::memory_order_relaxed);
+				_bottom.store(b, std::memory_order_seq_cst);
+				int64_t t = _top.load(std::memory_order_seq_cst);
+				if(t > b) {
+					_bottom.store(b+1, std::memory_order_release);
+					return NULL;
+				}
+				T* value = a->get(b);
+				if(t == b) {
+					if(!_top.compare_exchange_strong(t, t+1,
+								std::memory_order_seq_cst,
+								std::memory_order_relaxed)) {
+						value = NULL;
+					}
+					_bottom.store(b+1, std::memory_order_release);
+				}
+				return value;
+			}
+			
+			// Any thread, returns NULL when empty or when lost race with
+			// other stealer or owner.
+			inline T* steal() {
+				int64_t t = _top.load(std::memory_order_seq_cst);
+				int64_t b = _bottom.load(std::memory_order_seq_cst);
+				if(t >= b) {
+					return NULL;
+				}
+				array *a = _array.load(std::memory_order_acquire);
+				T* value = a->get(t);
+				if(!_top.compare_exchange_strong(t, t+1,
+							std::memory_order_seq_cst,
+							std::memory_order_relaxed)) {
+					return NULL;
+				}
+				return value;
+			}
+			
+			// Approximate when called concurrently.
+			inline size_t size() const {
+				int64_t b = _bottom.load(std::memory_order_relaxed);
+				int64_t t = _top.load(std::memory_order_relaxed);
+				return b > t ? b - t : 0;
+			}
+			
+			inline bool empty() const {
+				return size() == 0;
+			}
+			
+		private:
+			
+			struct array {
+				size_t mask;
+				array *previous;
+				std::atomic<T*> data[1];
+				
+				static array *create(size_t capacity, array *previous) {
+					array *a = (array*)malloc(sizeof(array) +
+							sizeof(std::atomic<T*>)*(capacity-1));
+					a->mask = capacity-1;
+					a->previous = previous;
+					for(size_t i=0; i<capacity; ++i) {
+						new(&a->data[i]) std::atomic<T*>(NULL);
+					}
+					return a;
+				}
+				
+				inline T* get(int64_t i) const {
+					return data[i & mask].load(std::memory_order_relaxed);
+				}
+				
+				inline void put(int64_t i, T* value) {
+					data[i & mask].store(value, std::memory_order_relaxed);
+				}
+			};
+			
+			array *grow(array *a, int64_t t, int64_t b) {
+				array *n = array::create((a->mask+1)*2, a);
+				for(int64_t i=t; i<b; ++i) {
+					n->put(i, a->get(i));
+				}
+				_array.store(n, std::memory_order_release);
+				return n;
+			}
+			
+		private:
+			
+			alignas(64) std::atomic<int64_t> _top;
+			alignas(64) std::atomic<int64_t> _bottom;
+			std::atomic<array*> _array;
+		};
+	}
+}
+
+#endif
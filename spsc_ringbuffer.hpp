@@ -10,6 +10,8 @@
 #include <cstdlib>
 #include <bit>
 
+#include "contention_stats.hpp"
+
 namespace concurrent {
 	namespace spsc {
 		template<typename T, size_t size>
@@ -32,13 +34,45 @@ namespace concurrent {
 			ringbuffer& operator=(ringbuffer&&) = delete;
 			ringbuffer& operator=(const ringbuffer&) = delete;
 			
-			inline bool is_empty() const { return _head == _tail; }
+			// Producer owns _head and consumer owns _tail, each is advanced
+			// with release store after accessing slot and the other side's
+			// index is read with acquire, so no RMW is needed.
+			inline bool is_empty() const {
+				return _head.load(std::memory_order_acquire) ==
+					_tail.load(std::memory_order_acquire);
+			}
 			inline bool is_not_empty() const { return !is_empty(); }
 			inline bool is_not_full() const { return !is_full(); }
-			inline bool is_full() const { return _head-size >= _tail; }
+			inline bool is_full() const {
+				return _head.load(std::memory_order_acquire) -
+					_tail.load(std::memory_order_acquire) >= size;
+			}
 			
 			
-			inline T& head() { return _data[_head&mask]; }
+			// Number of pushed and not yet popped values, exact for consumer,
+			// lower bound of free space for producer via count_free(), only
+			// a hint for other threads.
+			inline size_t count() const {
+				return _head.load(std::memory_order_acquire) -
+					_tail.load(std::memory_order_acquire);
+			}
+			inline size_t count_free() const {
+				return size - count();
+			}
+			
+			
+			inline T& head() {
+				return _data[_head.load(std::memory_order_relaxed)&mask];
+			}
+			// Batched push: fill head(0..n-1), then publish all with single
+			// push_n(n). Require n <= count_free()
+			inline T& head(size_t offset) {
+				return _data[(_head.load(std::memory_order_relaxed)+offset)&mask];
+			}
+			inline void push_n(size_t n) {
+				_head.store(_head.load(std::memory_order_relaxed)+n,
+						std::memory_order_release);
+			}
 			inline bool push(const T& value) {
 				if(is_full())
 					return false;
@@ -54,10 +88,24 @@ namespace concurrent {
 				return true;
 			}
 			// Require is_full() == false
-			inline void push() { ++_head;}
+			inline void push() {
+				_head.store(_head.load(std::memory_order_relaxed)+1,
+						std::memory_order_release);
+			}
 			
 			
-			inline T& tail() { return _data[_tail&mask]; }
+			inline T& tail() {
+				return _data[_tail.load(std::memory_order_relaxed)&mask];
+			}
+			// Batched pop: read tail(0..n-1), then release all with single
+			// pop_n(n). Require n <= count()
+			inline T& tail(size_t offset) {
+				return _data[(_tail.load(std::memory_order_relaxed)+offset)&mask];
+			}
+			inline void pop_n(size_t n) {
+				_tail.store(_tail.load(std::memory_order_relaxed)+n,
+						std::memory_order_release);
+			}
 			inline bool pop(T& value) {
 				if(is_empty())
 					return false;
@@ -66,21 +114,35 @@ namespace concurrent {
 				return true;
 			}
 			// Require is_empty() == false
-			inline void pop() { ++_tail; }
+			inline void pop() {
+				_tail.store(_tail.load(std::memory_order_relaxed)+1,
+						std::memory_order_release);
+			}
 			
 			
+			// Consumer side, drops everything pushed so far.
 			void clear() {
-				size_t value = _tail, h = _head;
-				while(_tail.compare_exchange_weak(h, value)) {
-					h = _head;
-					value = _tail;
+				size_t t = _tail.load(std::memory_order_relaxed);
+				for(;;) {
+					size_t h = _head.load(std::memory_order_acquire);
+					if(_tail.compare_exchange_weak(t, h,
+								std::memory_order_release,
+								std::memory_order_relaxed))
+						return;
+					contention.add_cas_failure();
 				}
 			}
 			
 			T* data() { return _data; }
 			
+			// All zero unless compiled with CONCURRENT_CONTENTION_STATS.
+			inline contention_snapshot get_contention_stats() const {
+				return contention.snapshot();
+			}
+			
 		private:
 			std::atomic<size_t> _head, _tail;
+			[[no_unique_address]] contention_counters contention;
 			T _data[size];
 		};
 	}
@@ -0,0 +1,1954 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+// Randomized schedule stress test of lock-free primitives using relaxed and
+// acquire/release orderings. Every thread randomly yields or spins between
+// operations to vary interleavings, payloads are written non-atomically
+// before publication and validated after consumption. Build with
+// CONCURRENT_SANITIZE_THREAD=ON to have ThreadSanitizer check that orderings
+// establish required happens-before edges.
+//
+// Usage: concurrent_stress [rounds multiplier]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <numeric>
+#include <string>
+
+#include "../mpsc_stack.hpp"
+#include "../mpsc_queue.hpp"
+#include "../mpmc_stack.hpp"
+#include "../bucket_pool.hpp"
+#include "../numa_pool.hpp"
+#include "../object_pool.hpp"
+#include "../broadcast_ring.hpp"
+#include "../pipeline.hpp"
+#include "../spsc_ringbuffer.hpp"
+#include "../spmc_deque.hpp"
+#include "../executor.hpp"
+#include "../parallel.hpp"
+#include "../futex.hpp"
+#include "../future.hpp"
+#include "../run_loop.hpp"
+#include "../coroutine.hpp"
+#include "../thread_safe_value.hpp"
+#include "../timer_wheel.hpp"
+#include "../locks.hpp"
+#include "../latency_histogram.hpp"
+#include "../trace.hpp"
+
+namespace
+{
+int failures = 0;
+uint64_t multiplier = 1;
+
+#define STRESS_CHECK(COND)                                                     \
+	do {                                                                       \
+		if (!(COND)) {                                                         \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+					#COND);                                                    \
+			++failures;                                                        \
+			return;                                                            \
+		}                                                                      \
+	} while (false)
+
+// Randomly does nothing, spins or yields, so threads interleave differently
+// on every run and every operation.
+void jitter()
+{
+	thread_local uint64_t state =
+		std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	switch (state & 15) {
+	case 0:
+		std::this_thread::yield();
+		break;
+	case 1:
+	case 2:
+		for (uint64_t i = 0; i < ((state >> 8) & 127); ++i) {
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+constexpr uint64_t PRODUCERS = 3;
+
+struct item : concurrent::node<item> {
+	uint64_t producer = 0;
+	uint64_t seq = 0;
+	uint64_t check = 0;
+	bool seen = false;
+};
+
+inline uint64_t checksum(uint64_t producer, uint64_t seq)
+{
+	return (producer * 0x9E3779B97F4A7C15ull) ^ ~seq;
+}
+
+std::vector<item> make_items(uint64_t per_producer)
+{
+	return std::vector<item>(per_producer * PRODUCERS);
+}
+
+template <typename P> void run_producers(uint64_t per_producer, P &&produce)
+{
+	std::vector<std::thread> threads;
+	for (uint64_t p = 0; p < PRODUCERS; ++p) {
+		threads.emplace_back([&, p]() {
+			for (uint64_t i = 0; i < per_producer; ++i) {
+				produce(p, i);
+				jitter();
+			}
+		});
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+}
+
+// Consumer alternates pop() and pop_all(), every item has to arrive exactly
+// once with payload written by producer.
+template <typename Backoff> void mpsc_stack()
+{
+	const uint64_t per_producer = 100'000 * multiplier;
+	std::vector<item> items = make_items(per_producer);
+	concurrent::mpsc::stack<item, Backoff> stack;
+	uint64_t received = 0;
+	bool ok = true;
+	auto consume = [&](item *it) {
+		if (it->check != checksum(it->producer, it->seq) || it->seen) {
+			ok = false;
+		}
+		it->seen = true;
+		++received;
+	};
+	std::thread consumer([&]() {
+		for (uint64_t round = 0; received < items.size(); ++round) {
+			if (round & 1) {
+				for (item *it = stack.pop_all(); it != NULL;) {
+					item *next = it->__m_next.load(std::memory_order_relaxed);
+					consume(it);
+					it = next;
+				}
+			} else if (item *it = stack.pop()) {
+				consume(it);
+			}
+			jitter();
+		}
+	});
+	run_producers(per_producer, [&](uint64_t p, uint64_t i) {
+		item &it = items[p * per_producer + i];
+		it.producer = p;
+		it.seq = i;
+		it.check = checksum(p, i);
+		stack.push(&it);
+	});
+	consumer.join();
+	STRESS_CHECK(ok);
+	STRESS_CHECK(received == items.size());
+	STRESS_CHECK(stack.empty());
+}
+
+// Items of each producer have to arrive in order of pushing.
+void mpsc_queue()
+{
+	const uint64_t per_producer = 100'000 * multiplier;
+	std::vector<item> items = make_items(per_producer);
+	concurrent::mpsc::queue<item> queue;
+	bool ok = true;
+	std::thread consumer([&]() {
+		uint64_t next_seq[PRODUCERS] = {};
+		for (uint64_t received = 0; received < items.size();) {
+			item *it = queue.pop();
+			if (it != NULL) {
+				if (it->check != checksum(it->producer, it->seq) ||
+					it->seq != next_seq[it->producer]) {
+					ok = false;
+				}
+				next_seq[it->producer] = it->seq + 1;
+				++received;
+			}
+			jitter();
+		}
+	});
+	run_producers(per_producer, [&](uint64_t p, uint64_t i) {
+		item &it = items[p * per_producer + i];
+		it.producer = p;
+		it.seq = i;
+		it.check = checksum(p, i);
+		queue.push(&it);
+	});
+	consumer.join();
+	STRESS_CHECK(ok);
+	STRESS_CHECK(queue.empty());
+}
+
+// Free-list churn with elimination, every thread pops node, rewrites its
+// payload and pushes it back. Node has to be owned by one thread at a time
+// and none may be lost or duplicated.
+template <typename Backoff> void mpmc_stack_elimination()
+{
+	const uint64_t per_thread = 100'000 * multiplier;
+	std::vector<item> items(PRODUCERS * 2);
+	concurrent::mpmc::mpmc_stack<item, std::mutex, Backoff, 2> stack;
+	for (item &it : items) {
+		it.check = checksum(0, 0);
+		stack.push(&it);
+	}
+	std::atomic<uint64_t> bad = 0;
+	run_producers(per_thread, [&](uint64_t p, uint64_t i) {
+		item *it = stack.pop();
+		if (it == NULL) {
+			return;
+		}
+		if (it->seen || it->check != checksum(it->producer, it->seq)) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+		it->seen = true;
+		it->producer = p;
+		it->seq = i;
+		it->check = checksum(p, i);
+		jitter();
+		it->seen = false;
+		stack.push(it);
+	});
+	uint64_t count = 0;
+	for (item *it = stack.pop_all(); it != NULL;
+		 it = it->__m_next.load(std::memory_order_relaxed)) {
+		STRESS_CHECK(it->seen == false);
+		it->seen = true;
+		++count;
+	}
+	STRESS_CHECK(bad.load() == 0);
+	STRESS_CHECK(count == items.size());
+}
+
+// Single slot with few nodes, so nodes are often taken and offered again
+// into the same slot before their first offerer withdraws. Whoever ends up
+// owning a node, by take() or by withdrawing offer, has to see payload
+// written by its previous owner.
+void elimination_reoffer()
+{
+	const uint64_t per_thread = 20'000 * multiplier;
+	std::vector<item> items(2);
+	for (item &it : items) {
+		it.check = checksum(0, 0);
+	}
+	concurrent::mpmc::detail::elimination_array<item, 1> array;
+	std::mutex mutex;
+	std::vector<item *> left;
+	std::atomic<uint64_t> bad = 0;
+	std::vector<std::thread> threads;
+	for (uint64_t p = 0; p < PRODUCERS; ++p) {
+		threads.emplace_back([&, p]() {
+			item *mine = p < items.size() ? &items[p] : NULL;
+			for (uint64_t i = 0; i < per_thread; ++i) {
+				if (mine == NULL && (mine = array.take()) == NULL) {
+					jitter();
+					continue;
+				}
+				if (mine->seen || mine->check != checksum(mine->producer,
+														  mine->seq)) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+				mine->seen = true;
+				mine->producer = p;
+				mine->seq = i;
+				mine->check = checksum(p, i);
+				mine->seen = false;
+				if (array.offer(mine)) {
+					mine = NULL;
+				}
+				jitter();
+			}
+			if (mine != NULL) {
+				std::lock_guard lock(mutex);
+				left.push_back(mine);
+			}
+		});
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	while (item *it = array.take()) {
+		left.push_back(it);
+	}
+	std::sort(left.begin(), left.end());
+	STRESS_CHECK(bad.load() == 0);
+	STRESS_CHECK(left.size() == items.size());
+	STRESS_CHECK(std::adjacent_find(left.begin(), left.end()) == left.end());
+}
+
+// Global pool shrinks by trim(), watermarks and scavenger while threads churn
+// objects through it, memory resident has to match objects held in it once
+// thread local pools are gone.
+void bucket_pool_trim()
+{
+	using tls_pool = nonconcurrent::thread_local_pool<64, 8>;
+	constexpr uint64_t BUCKET = 8 * 64;
+	concurrent::buckets_pool<64> pool(64);
+	auto churn = [&](uint64_t objects) {
+		tls_pool tls(&pool);
+		std::vector<uint64_t *> held;
+		for (uint64_t i = 0; i < objects; ++i) {
+			held.push_back(tls.acquire<uint64_t>(i));
+		}
+		for (uint64_t *o : held) {
+			tls.release(o);
+		}
+	};
+	churn(32 * 8);
+	STRESS_CHECK(pool.count_objects_in_global_pool() == 32 * 8);
+	STRESS_CHECK(pool.trim(10 * BUCKET) == 22 * BUCKET);
+	STRESS_CHECK(pool.count_objects_in_global_pool() == 10 * 8);
+	STRESS_CHECK(pool.current_memory_resident() == 10 * BUCKET);
+
+	pool.set_watermarks(16, 4);
+	STRESS_CHECK(pool.count_objects_in_global_pool() == 10 * 8);
+	churn(32 * 8);
+	STRESS_CHECK(pool.count_objects_in_global_pool() <= 16 * 8);
+	STRESS_CHECK(pool.current_memory_resident() ==
+				 pool.count_objects_in_global_pool() * 64);
+
+	// Watermarks are reapplied and read without lock meanwhile.
+	pool.start_scavenger(concurrent::time::microseconds(100), 2, false);
+	std::atomic<uint64_t> bad = 0;
+	std::vector<std::thread> threads;
+	for (uint64_t p = 0; p < PRODUCERS; ++p) {
+		threads.emplace_back([&, p]() {
+			for (uint64_t i = 0; i < 2'000 * multiplier; ++i) {
+				churn(1 + i % 64);
+				if (p == 0 && i % 64 == 0) {
+					pool.set_watermarks(16, 4);
+				}
+				if (pool.get_high_watermark() != 16 ||
+					pool.get_low_watermark() != 4) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+				jitter();
+			}
+		});
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	pool.stop_scavenger();
+	STRESS_CHECK(bad == 0);
+	STRESS_CHECK(pool.count_objects_in_global_pool() <= 16 * 8);
+	STRESS_CHECK(pool.current_memory_resident() ==
+				 pool.count_objects_in_global_pool() * 64);
+
+	// Untouched buckets above low watermark are freed by second step, so
+	// third has nothing to free. Churn may leave partially filled buckets.
+	churn(8 * 8);
+	pool.scavenge(64);
+	pool.scavenge(64);
+	STRESS_CHECK(pool.scavenge(64) == 0);
+	STRESS_CHECK(pool.count_objects_in_global_pool() > 0);
+	STRESS_CHECK(pool.count_objects_in_global_pool() <= 4 * 8);
+	STRESS_CHECK(pool.current_memory_resident() ==
+				 pool.count_objects_in_global_pool() * 64);
+	STRESS_CHECK(pool.count_trimmed_buckets() > 0);
+}
+
+// Thread that only acquires has to refill whole bucket_size per trip to
+// global pool, whether global pool is empty (batch allocation) or holds
+// buckets flushed by other thread.
+void bucket_pool_refill()
+{
+	using tls_pool = nonconcurrent::thread_local_pool<64, 256>;
+	const uint64_t n = 20'000 * multiplier;
+	concurrent::buckets_pool<64> pool(n);
+	std::vector<uint64_t *> objects;
+	uint64_t refills = 0;
+	{
+		tls_pool tls(&pool);
+		for (uint64_t i = 0; i < n; ++i) {
+			objects.push_back(tls.acquire<uint64_t>(i));
+		}
+		refills = tls.count_global_refills();
+		STRESS_CHECK(tls.current_bucket_size() == 256);
+	}
+	STRESS_CHECK(refills * 16 < n);
+	const uint64_t allocated = pool.estimate_system_allocations();
+	bool corrupted = false;
+	std::thread releaser([&]() {
+		tls_pool tls(&pool);
+		for (uint64_t i = 0; i < n; ++i) {
+			corrupted |= *objects[i] != i;
+			tls.release(objects[i]);
+			jitter();
+		}
+	});
+	releaser.join();
+	STRESS_CHECK(corrupted == false);
+	{
+		tls_pool tls(&pool);
+		for (uint64_t i = 0; i < n; ++i) {
+			objects[i] = tls.acquire<uint64_t>(i);
+		}
+		refills = tls.count_global_refills();
+		for (uint64_t i = 0; i < n; ++i) {
+			corrupted |= *objects[i] != i;
+			tls.release(objects[i]);
+		}
+	}
+	STRESS_CHECK(corrupted == false);
+	STRESS_CHECK(refills * 16 < n);
+	STRESS_CHECK(pool.estimate_system_allocations() == allocated);
+	STRESS_CHECK(pool.count_objects_in_global_pool() == allocated);
+}
+
+// Buckets stolen across node pools and freed by thief, memory resident has
+// to follow objects instead of wrapping around in either pool.
+void numa_pool_steal()
+{
+	using tls_pool = nonconcurrent::thread_local_pool<64, 32>;
+	const uint64_t n = 10'000 * multiplier;
+	concurrent::numa_buckets_pool<64> pool(n, 2);
+	std::vector<uint64_t *> objects;
+	std::thread owner([&]() {
+		tls_pool tls(pool.pool_for_node(0));
+		for (uint64_t i = 0; i < n; ++i) {
+			objects.push_back(tls.acquire<uint64_t>(i));
+		}
+		for (uint64_t *o : objects) {
+			tls.release(o);
+		}
+	});
+	owner.join();
+	const uint64_t allocated = pool.pool_for_node(0)->current_memory_resident();
+	std::thread thief([&]() {
+		tls_pool tls(pool.pool_for_node(1));
+		for (uint64_t i = 0; i < n; ++i) {
+			objects[i] = tls.acquire<uint64_t>(i);
+			jitter();
+		}
+		for (uint64_t *o : objects) {
+			tls.release(o);
+		}
+	});
+	thief.join();
+	STRESS_CHECK(pool.count_bucket_steals() > 0);
+	STRESS_CHECK(pool.current_memory_resident() == allocated);
+	pool.pool_for_node(1)->free_all();
+	STRESS_CHECK(pool.pool_for_node(0)->current_memory_resident() <= allocated);
+	STRESS_CHECK(pool.pool_for_node(1)->current_memory_resident() == 0);
+	pool.free_all();
+	STRESS_CHECK(pool.current_memory_resident() == 0);
+}
+
+struct tracked {
+	inline static std::atomic<int64_t> live = 0;
+	uint64_t value;
+	uint64_t check;
+
+	// Throws when countdown reaches 0.
+	tracked(uint64_t value, int *countdown = NULL)
+		: value(value), check(checksum(1, value))
+	{
+		if (countdown != NULL && --*countdown == 0) {
+			throw 0;
+		}
+		live.fetch_add(1, std::memory_order_relaxed);
+	}
+	tracked(const tracked &other) : tracked(other.value) {}
+	~tracked() { live.fetch_sub(1, std::memory_order_relaxed); }
+};
+
+// Handles acquired one by one and in batches are released on consumer
+// thread. Every object has to be constructed and destroyed exactly once,
+// also when constructor throws.
+void object_pool_handles()
+{
+	using pool = concurrent::object_pool<tracked>;
+	const uint64_t per_producer = 20'000 * multiplier;
+	std::mutex mutex;
+	std::vector<pool::handle> shared;
+	bool ok = true;
+	std::thread consumer([&]() {
+		std::vector<pool::handle> taken;
+		uint64_t received = 0;
+		while (received < per_producer * PRODUCERS) {
+			{
+				std::lock_guard lock(mutex);
+				taken.swap(shared);
+			}
+			for (pool::handle &h : taken) {
+				ok &= h->check == checksum(1, h->value);
+			}
+			received += taken.size();
+			taken.clear();
+			jitter();
+		}
+	});
+	run_producers(per_producer / 8, [&](uint64_t p, uint64_t i) {
+		pool::handle batch[8];
+		if (i & 1) {
+			pool::acquire_n(batch, 8, p * per_producer + i);
+		} else {
+			tracked *raw[8];
+			pool::acquire_n(raw, 8, p * per_producer + i);
+			for (size_t k = 0; k < 8; ++k) {
+				batch[k].reset(raw[k]);
+			}
+		}
+		std::lock_guard lock(mutex);
+		for (pool::handle &h : batch) {
+			shared.push_back(std::move(h));
+		}
+	});
+	consumer.join();
+	STRESS_CHECK(ok);
+	STRESS_CHECK(tracked::live.load() == 0);
+
+	int countdown = 1;
+	bool thrown = false;
+	try {
+		pool::handle h = pool::acquire(1, &countdown);
+	} catch (int) {
+		thrown = true;
+	}
+	STRESS_CHECK(thrown && tracked::live.load() == 0);
+	tracked *raw[8];
+	countdown = 5;
+	thrown = false;
+	try {
+		pool::acquire_n(raw, 8, 1, &countdown);
+	} catch (int) {
+		thrown = true;
+	}
+	STRESS_CHECK(thrown && tracked::live.load() == 0);
+	{
+		std::shared_ptr<tracked> shared_obj =
+			std::allocate_shared<tracked>(pool::allocator<tracked>(), 7);
+		STRESS_CHECK(tracked::live.load() == 1 && shared_obj->value == 7);
+	}
+	STRESS_CHECK(tracked::live.load() == 0);
+}
+
+// Small ring wraps around constantly, slots are overwritten right after
+// consumer frees them.
+void spsc_ringbuffer()
+{
+	struct slot {
+		uint64_t seq;
+		uint64_t check;
+	};
+	const uint64_t count = 1'000'000 * multiplier;
+	concurrent::spsc::ringbuffer<slot, 4> ring;
+	bool ok = true;
+	std::thread consumer([&]() {
+		slot s;
+		for (uint64_t i = 0; i < count;) {
+			if (i & 1) {
+				if (ring.pop(s)) {
+					if (s.seq != i || s.check != checksum(1, i)) {
+						ok = false;
+					}
+					++i;
+				}
+			} else if (ring.is_not_empty()) {
+				if (ring.tail().seq != i || ring.tail().check != checksum(1, i)) {
+					ok = false;
+				}
+				ring.pop();
+				++i;
+			}
+			jitter();
+		}
+	});
+	for (uint64_t i = 0; i < count;) {
+		if (i & 1) {
+			if (ring.push(slot{i, checksum(1, i)})) {
+				++i;
+			}
+		} else if (ring.is_not_full()) {
+			ring.head() = {i, checksum(1, i)};
+			ring.push();
+			++i;
+		}
+		jitter();
+	}
+	consumer.join();
+	STRESS_CHECK(ok);
+	STRESS_CHECK(ring.is_empty());
+}
+
+// Events are claimed in batches of 1 to 3 into small ring that wraps
+// constantly. Two consumers of first stage check every event and annotate
+// own field of it, consumer of second stage depends on both and checks
+// their annotations. Every consumer has to see events of each producer in
+// order of publishing.
+template <typename Producer, typename Wait> void broadcast_ring()
+{
+	struct event {
+		uint64_t producer;
+		uint64_t seq;
+		uint64_t check;
+		uint64_t first[2];
+	};
+	constexpr uint64_t producers =
+		std::is_same_v<Producer, concurrent::broadcast::multi_producer>
+			? PRODUCERS
+			: 1;
+	const uint64_t per_producer = 50'000 * multiplier;
+	const uint64_t total = per_producer * producers;
+	auto *ring = new concurrent::broadcast::ring<event, 16, Producer, Wait>();
+	concurrent::broadcast::sequence first[2], second;
+	auto first_barrier = ring->new_barrier();
+	auto second_barrier = ring->new_barrier({&first[0], &first[1]});
+	ring->add_gating_sequence(second);
+	std::atomic<uint64_t> bad = 0;
+	auto consume = [&](auto &barrier, concurrent::broadcast::sequence &seq,
+					   auto &&check) {
+		uint64_t next_seq[PRODUCERS] = {};
+		for (uint64_t received = 0; received < total;) {
+			received += barrier.process(seq, [&](event &e, int64_t, bool) {
+				if (e.check != checksum(e.producer, e.seq) ||
+					e.seq != next_seq[e.producer] || check(e) == false) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+				next_seq[e.producer] = e.seq + 1;
+			});
+			jitter();
+		}
+	};
+	std::vector<std::thread> consumers;
+	for (uint64_t c = 0; c < 2; ++c) {
+		consumers.emplace_back([&, c]() {
+			consume(first_barrier, first[c], [c](event &e) {
+				e.first[c] = e.check + c;
+				return true;
+			});
+		});
+	}
+	consumers.emplace_back([&]() {
+		consume(second_barrier, second, [](event &e) {
+			return e.first[0] == e.check && e.first[1] == e.check + 1;
+		});
+	});
+	std::vector<std::thread> threads;
+	for (uint64_t p = 0; p < producers; ++p) {
+		threads.emplace_back([&, p]() {
+			for (uint64_t i = 0; i < per_producer;) {
+				const uint64_t n =
+					std::min<uint64_t>(i % 3 + 1, per_producer - i);
+				int64_t seq;
+				if ((i & 4) == 0 || ring->try_claim(seq, n) == false) {
+					seq = ring->claim(n);
+				}
+				for (uint64_t k = 0; k < n; ++k, ++i) {
+					(*ring)[seq + k] = {p, i, checksum(p, i), {0, 0}};
+				}
+				jitter();
+				ring->publish(seq, n);
+			}
+		});
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	for (std::thread &t : consumers) {
+		t.join();
+	}
+	STRESS_CHECK(bad.load() == 0);
+	STRESS_CHECK(second.get() == (int64_t)total - 1);
+	STRESS_CHECK(ring->cursor() == (int64_t)total - 1);
+	delete ring;
+}
+
+// Source, filtering stage, mapping stage and sink connected by rings of 4
+// slots, so stages constantly wait on full output and on empty input.
+// Values have to arrive in order with payloads written by previous stage.
+// Second round runs unbounded source until stop(), everything produced
+// before has to drain.
+void pipeline()
+{
+	struct value {
+		uint64_t seq;
+		uint64_t check;
+	};
+	const uint64_t count = 100'000 * multiplier;
+	for (int round = 0; round < 2; ++round) {
+		concurrent::channel<value, 4> produced, filtered;
+		concurrent::channel<uint64_t, 4> mapped;
+		concurrent::pipeline p(3);
+		uint64_t next = 0, expected = 0, received = 0;
+		bool ok = true;
+		p.add_source("source",
+					 [&](value &v) {
+						 if (round == 0 && next == count) {
+							 return false;
+						 }
+						 v = {next, checksum(2, next)};
+						 ++next;
+						 jitter();
+						 return true;
+					 },
+					 produced);
+		p.add_stage("filter", produced,
+					[&](value &in, value &out) {
+						if (in.check != checksum(2, in.seq)) {
+							ok = false;
+						}
+						out = in;
+						jitter();
+						return in.seq % 3 != 0;
+					},
+					filtered);
+		p.add_stage("map", filtered,
+					[&](value &in, uint64_t &out) {
+						out = in.check == checksum(2, in.seq) ? in.seq : ~0ull;
+						return true;
+					},
+					mapped);
+		p.add_sink("sink", mapped, [&](uint64_t &v) {
+			if (expected % 3 == 0) {
+				++expected;
+			}
+			if (v != expected) {
+				ok = false;
+			}
+			++expected;
+			++received;
+			jitter();
+		});
+		// Monitor polls stats() while start() runs and stages make progress,
+		// counters may only grow.
+		std::atomic<bool> joined = false;
+		bool monitor_ok = true;
+		std::thread monitor([&]() {
+			uint64_t last = 0;
+			while (joined.load(std::memory_order_acquire) == false) {
+				const std::vector<concurrent::stage_stats> st = p.stats();
+				if (st[3].items_in < last || st[3].throughput < 0) {
+					monitor_ok = false;
+				}
+				last = st[3].items_in;
+				std::this_thread::yield();
+			}
+		});
+		p.start();
+		if (round == 1) {
+			while (p.stats()[3].items_in < count) {
+				std::this_thread::yield();
+			}
+			p.stop();
+		}
+		p.join();
+		joined.store(true, std::memory_order_release);
+		monitor.join();
+		STRESS_CHECK(monitor_ok);
+		STRESS_CHECK(p.is_finished());
+		const std::vector<concurrent::stage_stats> st = p.stats();
+		STRESS_CHECK(ok);
+		STRESS_CHECK(round == 1 || next == count);
+		STRESS_CHECK(received == next - (next + 2) / 3);
+		STRESS_CHECK(st[0].items_out == next);
+		STRESS_CHECK(st[1].items_in == next && st[1].items_out == received);
+		STRESS_CHECK(st[3].items_in == received && st[3].queue_depth == 0);
+	}
+}
+
+// Value set on one thread races with continuation registration and waiting
+// on others, continuation has to run exactly once and observe value.
+void future_continuations()
+{
+	const uint64_t rounds = 20'000 * multiplier;
+	std::atomic<uint64_t> ran = 0;
+	std::atomic<uint64_t> bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		std::thread setter([&]() {
+			jitter();
+			p.set_value(r);
+		});
+		std::thread registrar([&]() {
+			jitter();
+			f.on_finish([&, r](concurrent::future<uint64_t> &self) {
+				if (self.has_value() == false || self.get() != r) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+				ran.fetch_add(1, std::memory_order_relaxed);
+			});
+		});
+		jitter();
+		if (f.get() != r) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+		setter.join();
+		registrar.join();
+	}
+	STRESS_CHECK(bad.load() == 0);
+	STRESS_CHECK(ran.load() == rounds);
+}
+
+// Promises are finished on several threads, some with error, while
+// combinators register on them. when_all() has to finish only after all
+// inputs, when_any() with index of an input which is already finished.
+void future_when_all_any()
+{
+	constexpr uint64_t N = 6;
+	const uint64_t rounds = 5'000 * multiplier;
+	std::atomic<uint64_t> bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		std::vector<concurrent::promise<uint64_t>> promises(N);
+		std::vector<concurrent::future<uint64_t>> futures;
+		for (concurrent::promise<uint64_t> &p : promises) {
+			futures.push_back(p.get_future());
+		}
+		concurrent::promise<int> extra;
+		auto any = concurrent::when_any(futures);
+		auto all = concurrent::when_all(futures);
+		auto tuple = concurrent::when_all(futures[0], extra.get_future());
+		std::vector<std::thread> threads;
+		for (uint64_t t = 0; t < PRODUCERS; ++t) {
+			threads.emplace_back([&, t]() {
+				for (uint64_t i = t; i < N; i += PRODUCERS) {
+					jitter();
+					if ((i + r) % 5 == 0) {
+						promises[i].set_error();
+					} else {
+						promises[i].set_value(r * N + i);
+					}
+				}
+				if (t == 0) {
+					extra.set_value(7);
+				}
+			});
+		}
+		const concurrent::when_any_result<uint64_t> &first = any.get();
+		if (first.index >= N || first.futures[first.index].finished() == false) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+		for (concurrent::future<uint64_t> &f : all.get()) {
+			if (f.finished() == false) {
+				bad.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		for (uint64_t i = 0; i < N; ++i) {
+			concurrent::future<uint64_t> &f = all.get()[i];
+			if (f.has_value() != ((i + r) % 5 != 0) ||
+				(f.has_value() && f.get() != r * N + i)) {
+				bad.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		auto &[a, b] = tuple.get();
+		if (a.finished() == false || b.has_value() == false || b.get() != 7) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+		for (std::thread &t : threads) {
+			t.join();
+		}
+	}
+	STRESS_CHECK(bad.load() == 0);
+	auto none = concurrent::when_any(std::vector<concurrent::future<int>>());
+	STRESS_CHECK(none.finished() && none.get().index == (size_t)-1);
+	auto empty = concurrent::when_all(std::vector<concurrent::future<int>>());
+	STRESS_CHECK(empty.finished() && empty.get().empty());
+}
+
+// Wake races with deadline of futex::wait_until() and future::wait_for().
+// Timed out wait has to return only after its deadline, finished wait has
+// to observe the value which woke it.
+void futex_timed_wait()
+{
+	namespace time = concurrent::time;
+	std::atomic<uint32_t> word = 0;
+	time::point deadline = time::now() + time::milliseconds(2);
+	while (concurrent::futex::wait_until(&word, 0, deadline)) {
+	}
+	STRESS_CHECK(time::now().ns >= deadline.ns);
+
+	const uint64_t rounds = 2'000 * multiplier;
+	std::atomic<uint64_t> bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		word.store(0, std::memory_order_relaxed);
+		deadline = time::now() + time::microseconds(r % 50);
+		std::thread waker([&]() {
+			jitter();
+			word.store(1, std::memory_order_release);
+			concurrent::futex::wake_all(&word);
+		});
+		while (word.load(std::memory_order_acquire) == 0) {
+			if (concurrent::futex::wait_until(&word, 0, deadline) == false) {
+				if (time::now().ns < deadline.ns) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+				break;
+			}
+		}
+		waker.join();
+
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		std::thread setter([&]() {
+			jitter();
+			p.set_value(r);
+		});
+		const time::point start = time::now();
+		const time::diff wait_time = time::microseconds(r % 50);
+		if (f.wait_for(wait_time)) {
+			if (f.finished() == false || f.get() != r) {
+				bad.fetch_add(1, std::memory_order_relaxed);
+			}
+		} else if ((time::now() - start).ns < wait_time.ns) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+		setter.join();
+	}
+	STRESS_CHECK(bad.load() == 0);
+
+	// Woken long before deadline.
+	word.store(0);
+	bool timed_out = false;
+	std::thread waiter([&]() {
+		while (word.load(std::memory_order_acquire) == 0) {
+			timed_out |= concurrent::futex::wait_until(
+							 &word, 0, time::now() + time::seconds(10)) == false;
+		}
+	});
+	jitter();
+	word.store(1, std::memory_order_release);
+	concurrent::futex::wake_all(&word);
+	waiter.join();
+	STRESS_CHECK(timed_out == false);
+}
+
+struct counted {
+	inline static std::atomic<int64_t> live = 0;
+	uint64_t value = 0;
+
+	counted() { live.fetch_add(1, std::memory_order_relaxed); }
+	counted(const counted &other) : value(other.value)
+	{
+		live.fetch_add(1, std::memory_order_relaxed);
+	}
+	counted &operator=(const counted &) = default;
+	~counted() { live.fetch_sub(1, std::memory_order_relaxed); }
+};
+
+// Copies of future are made and dropped on several threads while promise
+// is set or abandoned. Pooled state has to be released exactly once, after
+// its last reference, so its value is destroyed exactly once.
+void future_refcount()
+{
+	const uint64_t rounds = 5'000 * multiplier;
+	std::atomic<uint64_t> bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		const bool abandon = r & 1;
+		auto *p = new concurrent::promise<counted>();
+		concurrent::future<counted> f = p->get_future();
+		std::vector<std::thread> threads;
+		for (uint64_t t = 0; t < PRODUCERS; ++t) {
+			threads.emplace_back([&, g = f]() mutable {
+				concurrent::future<counted> copy = g;
+				jitter();
+				g = concurrent::future<counted>();
+				concurrent::future<counted> moved = std::move(copy);
+				moved.wait();
+				if (moved.has_value() == abandon ||
+					(abandon == false && moved.get().value != r)) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		}
+		jitter();
+		if (abandon == false) {
+			counted v;
+			v.value = r;
+			p->set_value(v);
+		}
+		delete p;
+		f = concurrent::future<counted>();
+		for (std::thread &t : threads) {
+			t.join();
+		}
+		if (counted::live.load() != 0) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	STRESS_CHECK(bad.load() == 0);
+	// Sole owner releases without touching shared counter.
+	{
+		concurrent::promise<counted> p;
+		p.set_value(counted());
+	}
+	STRESS_CHECK(counted::live.load() == 0);
+}
+
+// Readers check that now_fast() never goes back while clock is repeatedly
+// recalibrated, and that calibrated clock follows now().
+void time_now_fast()
+{
+	namespace time = concurrent::time;
+	std::atomic<bool> stop = false;
+	std::atomic<uint64_t> bad = 0;
+	std::vector<std::thread> readers;
+	for (uint64_t t = 0; t < PRODUCERS; ++t) {
+		readers.emplace_back([&]() {
+			time::point last = time::now_fast();
+			while (stop.load(std::memory_order_relaxed) == false) {
+				const time::point p = time::now_fast();
+				if (p.ns < last.ns) {
+					bad.fetch_add(1, std::memory_order_relaxed);
+				}
+				last = p;
+				jitter();
+			}
+		});
+	}
+	const time::point end = time::now() + time::milliseconds(50 * multiplier);
+	while (time::now().ns < end.ns) {
+		time::recalibrate_fast_clock();
+		std::this_thread::yield();
+	}
+	stop.store(true);
+	for (std::thread &t : readers) {
+		t.join();
+	}
+	STRESS_CHECK(bad.load() == 0);
+
+	// Both clocks share epoch and rate, within generous bounds for a loaded
+	// machine.
+	const time::point fast_start = time::now_fast();
+	const time::point start = time::now();
+	STRESS_CHECK(time::abs(fast_start - start).ns < 5'000'000);
+	time::sleep_for(time::milliseconds(20));
+	const time::diff fast_elapsed = time::now_fast() - fast_start;
+	const time::diff elapsed = time::now() - start;
+	STRESS_CHECK(time::abs(fast_elapsed - elapsed).ns <
+				 elapsed.ns / 10 + 5'000'000);
+}
+
+inline uint64_t next_random(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+// Virtual time in microsecond ticks. First timers spanning four levels are
+// advanced in random steps, every one has to fire in the step containing its
+// deadline after cascading down, cancelled ones never. Then threads
+// schedule and cancel while owner advances, every timer has to either fire
+// not before its deadline or be cancelled, never both.
+void timer_wheel_fire_cancel()
+{
+	namespace time = concurrent::time;
+	auto at = [](int64_t tick) { return time::point{tick * 1000}; };
+	{
+		constexpr uint64_t N = 20'000;
+		concurrent::timer_wheel wheel(time::microseconds(1), at(0));
+		std::vector<int64_t> deadline(N), fired_prev(N, -1), fired_now(N, -1);
+		std::vector<concurrent::timer_wheel::timer> timers;
+		int64_t prev = 0, now = 0, last = 0;
+		uint64_t rng = 0x9E3779B97F4A7C15ull;
+		for (uint64_t i = 0; i < N; ++i) {
+			deadline[i] = 1 + next_random(rng) % (1 << 22);
+			last = std::max(last, deadline[i]);
+			timers.push_back(wheel.schedule(at(deadline[i]), [&, i]() {
+				fired_prev[i] = prev;
+				fired_now[i] = now;
+			}));
+		}
+		for (uint64_t i = 0; i < N; i += 7) {
+			STRESS_CHECK(timers[i].cancel());
+		}
+		while (now < last) {
+			prev = now;
+			now += 1 + next_random(rng) % 5'000;
+			wheel.advance(at(now));
+		}
+		for (uint64_t i = 0; i < N; ++i) {
+			if (i % 7 == 0) {
+				STRESS_CHECK(fired_now[i] == -1 && timers[i].fired() == false);
+			} else {
+				STRESS_CHECK(timers[i].fired());
+				STRESS_CHECK(fired_prev[i] < deadline[i] &&
+							 deadline[i] <= fired_now[i]);
+			}
+		}
+		STRESS_CHECK(wheel.count_pending() == 0);
+	}
+
+	struct entry {
+		int64_t deadline = 0;
+		int64_t fired_at = -1;
+		bool cancelled = false;
+		concurrent::timer_wheel::timer handle;
+	};
+	const uint64_t per_thread = 20'000 * multiplier;
+	concurrent::timer_wheel wheel(time::microseconds(1), at(0));
+	std::vector<entry> entries(per_thread * PRODUCERS);
+	std::atomic<int64_t> now = 0;
+	std::atomic<uint64_t> scheduling = PRODUCERS;
+	std::thread owner([&]() {
+		uint64_t rng = 12345;
+		while (scheduling.load(std::memory_order_acquire) != 0) {
+			now.store(now.load(std::memory_order_relaxed) + 1 +
+						  next_random(rng) % 200,
+					  std::memory_order_relaxed);
+			wheel.advance(at(now.load(std::memory_order_relaxed)));
+			jitter();
+		}
+		now.store(now.load(std::memory_order_relaxed) + (1ll << 30),
+				  std::memory_order_relaxed);
+		wheel.advance(at(now.load(std::memory_order_relaxed)));
+	});
+	run_producers(per_thread, [&](uint64_t p, uint64_t i) {
+		thread_local uint64_t rng = 0;
+		rng = rng ? rng : p + 1;
+		entry &e = entries[p * per_thread + i];
+		e.deadline = now.load(std::memory_order_relaxed) + 1 +
+					 next_random(rng) % 100'000;
+		e.handle = wheel.schedule(at(e.deadline), [&e, &now]() {
+			e.fired_at = now.load(std::memory_order_relaxed);
+		});
+		if (i >= 10) {
+			entry &old = entries[p * per_thread + i - 10];
+			if (next_random(rng) % 3 == 0) {
+				old.cancelled = old.handle.cancel();
+			}
+		}
+		if (i + 1 == per_thread) {
+			scheduling.fetch_sub(1, std::memory_order_release);
+		}
+	});
+	owner.join();
+	for (entry &e : entries) {
+		STRESS_CHECK(e.cancelled == (e.fired_at < 0));
+		STRESS_CHECK(e.cancelled || e.fired_at >= e.deadline);
+		STRESS_CHECK(e.cancelled || e.handle.fired());
+	}
+	STRESS_CHECK(wheel.count_pending() == 0);
+}
+
+// Every value lies in bucket whose bounds are within 1/SUB_BUCKETS of it.
+// Threads record known values while reader takes snapshots, percentiles
+// have to be ordered and end up equal to upper bound of bucket holding the
+// exact quantile.
+void latency_histogram_bounds()
+{
+	using histogram = concurrent::latency_histogram;
+	std::vector<uint64_t> probes;
+	for (uint64_t v = 0; v < 4096; ++v) {
+		probes.push_back(v);
+	}
+	for (int e = 12; e < 63; ++e) {
+		probes.push_back((1ull << e) - 1);
+		probes.push_back(1ull << e);
+		probes.push_back((1ull << e) + 1);
+	}
+	probes.push_back(INT64_MAX);
+	int last_index = -1;
+	for (uint64_t v : probes) {
+		const int i = histogram::bucket_index(v);
+		STRESS_CHECK(i >= last_index && i < histogram::BUCKETS);
+		STRESS_CHECK(v <= (uint64_t)histogram::bucket_upper_bound(i));
+		STRESS_CHECK(i == 0 || v > (uint64_t)histogram::bucket_upper_bound(i - 1));
+		if (v >= histogram::SUB_BUCKETS) {
+			const uint64_t width = histogram::bucket_upper_bound(i) -
+								   histogram::bucket_upper_bound(i - 1);
+			STRESS_CHECK(width * histogram::SUB_BUCKETS <= v);
+		}
+		last_index = i;
+	}
+	STRESS_CHECK(histogram::bucket_index(INT64_MAX) == histogram::BUCKETS - 1);
+
+	const uint64_t per_thread = 100'000 * multiplier;
+	auto value = [](uint64_t p, uint64_t i) {
+		return (int64_t)((p * 104729 + i * 7919) % 10'000'000);
+	};
+	histogram h;
+	std::atomic<bool> done = false;
+	bool ordered = true;
+	std::thread reader([&]() {
+		while (done.load(std::memory_order_acquire) == false) {
+			const histogram::snapshot s = h.read();
+			ordered &= s.p50().ns <= s.p99().ns && s.p99().ns <= s.p999().ns &&
+					   s.p999().ns <= s.max().ns;
+			jitter();
+		}
+	});
+	run_producers(per_thread, [&](uint64_t p, uint64_t i) {
+		h.record(concurrent::time::diff{value(p, i)});
+	});
+	done.store(true, std::memory_order_release);
+	reader.join();
+	STRESS_CHECK(ordered);
+
+	std::vector<int64_t> all;
+	for (uint64_t p = 0; p < PRODUCERS; ++p) {
+		for (uint64_t i = 0; i < per_thread; ++i) {
+			all.push_back(value(p, i));
+		}
+	}
+	std::sort(all.begin(), all.end());
+	const histogram::snapshot s = h.read();
+	STRESS_CHECK(s.count() == all.size());
+	STRESS_CHECK(s.min().ns == all.front() && s.max().ns == all.back());
+	STRESS_CHECK(s.mean().ns == (int64_t)(std::accumulate(all.begin(), all.end(),
+														  (uint64_t)0) /
+										  all.size()));
+	for (double q : {0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+		const size_t rank = std::min<size_t>(q * all.size(), all.size() - 1);
+		const int64_t exact = all[rank];
+		const int64_t bound = std::min(
+			histogram::bucket_upper_bound(histogram::bucket_index(exact)),
+			all.back());
+		STRESS_CHECK(s.percentile(q).ns == bound);
+	}
+}
+
+// Loop is destroyed right after run_until() returns, while thread
+// finishing the future may still be running its continuation. Items
+// executed before completion have to run before run_until() returns.
+void run_loop_until()
+{
+	const uint64_t rounds = 10'000 * multiplier;
+	uint64_t bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		auto *loop = new concurrent::run_loop();
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		uint64_t ran = 0;
+		std::thread setter([&]() {
+			jitter();
+			loop->execute([&]() { ++ran; });
+			jitter();
+			p.set_value(r);
+		});
+		jitter();
+		if (loop->run_until(f) != r || loop->run_until(f) != r || ran != 1) {
+			++bad;
+		}
+		delete loop;
+		setter.join();
+	}
+	STRESS_CHECK(bad == 0);
+}
+
+concurrent::task<uint64_t> add_one(concurrent::future<uint64_t> f)
+{
+	const uint64_t v = co_await f;
+	co_return v + 1;
+}
+
+concurrent::task<void> maybe_throw(bool t)
+{
+	if (t) {
+		throw 1;
+	}
+	co_return;
+}
+
+concurrent::task<uint64_t> maybe_throw_value(bool t)
+{
+	if (t) {
+		throw 1;
+	}
+	co_return 7;
+}
+
+concurrent::task<void> await_maybe_throw(bool t, bool &ok)
+{
+	ok = (co_await maybe_throw(t)) == !t;
+	concurrent::task<uint64_t> v = maybe_throw_value(t);
+	const uint64_t got = co_await v;
+	ok = ok && v.is_valid() == !t && got == (t ? 0 : 7);
+}
+
+// Coroutine suspended on future is resumed by thread finishing promise.
+// Exception leaving task has to be reported by get(), co_await and
+// is_valid().
+void coroutine_task()
+{
+	const uint64_t rounds = 10'000 * multiplier;
+	uint64_t bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		concurrent::promise<uint64_t> p;
+		concurrent::task<uint64_t> t = add_one(p.get_future());
+		std::thread setter([&]() {
+			jitter();
+			p.set_value(r);
+		});
+		if (t.get() != r + 1) {
+			++bad;
+		}
+		setter.join();
+		bool ok = false;
+		if (await_maybe_throw(r & 1, ok).get() == false || ok == false ||
+			maybe_throw(r & 1).get() != ((r & 1) == 0) ||
+			maybe_throw_value(r & 1).is_valid() != ((r & 1) == 0)) {
+			++bad;
+		}
+	}
+	STRESS_CHECK(bad == 0);
+}
+
+// Owner pushes and pops at bottom of deque starting with 2 slots, so it
+// grows while two thieves steal from top. Every item has to be taken
+// exactly once with payload written before push.
+void spmc_deque()
+{
+	const uint64_t count = 200'000 * multiplier;
+	std::vector<item> items(count);
+	std::vector<std::atomic<uint32_t>> taken(count);
+	concurrent::spmc::deque<item> deque(2);
+	std::atomic<bool> done = false;
+	std::atomic<uint64_t> bad = 0;
+	auto take = [&](item *it) {
+		if (it->check != checksum(it->producer, it->seq) ||
+			taken[it->seq].fetch_add(1, std::memory_order_relaxed) != 0) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+	std::vector<std::thread> thieves;
+	for (int t = 0; t < 2; ++t) {
+		thieves.emplace_back([&]() {
+			while (done.load(std::memory_order_acquire) == false ||
+				   deque.empty() == false) {
+				if (item *it = deque.steal()) {
+					take(it);
+				}
+				jitter();
+			}
+		});
+	}
+	for (uint64_t i = 0; i < count; ++i) {
+		items[i].producer = 1;
+		items[i].seq = i;
+		items[i].check = checksum(1, i);
+		deque.push(&items[i]);
+		if ((i & 3) == 0) {
+			if (item *it = deque.pop()) {
+				take(it);
+			}
+		}
+		jitter();
+	}
+	while (item *it = deque.pop()) {
+		take(it);
+	}
+	done.store(true, std::memory_order_release);
+	for (std::thread &t : thieves) {
+		t.join();
+	}
+	uint64_t missing = 0;
+	for (std::atomic<uint32_t> &t : taken) {
+		missing += t.load() != 1;
+	}
+	STRESS_CHECK(bad.load() == 0);
+	STRESS_CHECK(missing == 0);
+}
+
+// External threads execute() tasks which submit nested tasks from worker
+// threads, executor is destroyed with work still pending and its
+// destructor has to run everything.
+void executor_pending()
+{
+	const uint64_t per_thread = 20'000 * multiplier;
+	std::atomic<uint64_t> ran = 0;
+	{
+		concurrent::executor ex(3);
+		run_producers(per_thread, [&](uint64_t, uint64_t i) {
+			ex.execute([&, i]() {
+				ran.fetch_add(1, std::memory_order_relaxed);
+				if ((i & 7) == 0) {
+					concurrent::executor::current()->execute([&]() {
+						ran.fetch_add(1, std::memory_order_relaxed);
+					});
+				}
+			});
+		});
+	}
+	STRESS_CHECK(ran.load() == PRODUCERS * (per_thread + (per_thread + 7) / 8));
+}
+
+// Every third submitted task throws, its future has to finish with error
+// while workers keep running the rest.
+void executor_throw()
+{
+	const uint64_t count = 20'000 * multiplier;
+	concurrent::executor ex(3);
+	std::vector<concurrent::future<uint64_t>> values;
+	std::vector<concurrent::future<bool>> voids;
+	for (uint64_t i = 0; i < count; ++i) {
+		values.push_back(ex.submit([i]() -> uint64_t {
+			if (i % 3 == 0) {
+				throw i;
+			}
+			return i;
+		}));
+		voids.push_back(ex.submit([i]() {
+			if (i % 3 == 1) {
+				throw i;
+			}
+		}));
+	}
+	uint64_t bad = 0;
+	for (uint64_t i = 0; i < count; ++i) {
+		values[i].wait();
+		voids[i].wait();
+		bad += values[i].has_value() != (i % 3 != 0);
+		bad += values[i].has_value() && values[i].get() != i;
+		bad += voids[i].has_value() != (i % 3 != 1);
+	}
+	STRESS_CHECK(bad == 0);
+}
+
+// Single task fans out whole tree of tasks from one worker, so other
+// workers get work only by stealing. Results come back through submit()
+// futures.
+void executor_steal()
+{
+	const uint64_t rounds = 200 * multiplier;
+	constexpr uint64_t FANOUT = 1000;
+	concurrent::executor ex(3);
+	for (uint64_t r = 0; r < rounds; ++r) {
+		std::atomic<uint64_t> sum = 0;
+		concurrent::future<uint64_t> root = ex.submit([&]() {
+			std::vector<concurrent::future<uint64_t>> children;
+			for (uint64_t i = 0; i < FANOUT; ++i) {
+				children.push_back(ex.submit([&, i]() {
+					sum.fetch_add(i, std::memory_order_relaxed);
+					jitter();
+					return i;
+				}));
+			}
+			uint64_t total = 0;
+			for (concurrent::future<uint64_t> &c : children) {
+				// Worker blocking on children is fine here, the others steal.
+				total += c.get();
+			}
+			return total;
+		});
+		const uint64_t expected = FANOUT * (FANOUT - 1) / 2;
+		STRESS_CHECK(root.get() == expected);
+		STRESS_CHECK(sum.load() == expected);
+	}
+}
+
+// Parallel algorithms against std ones on 1 and 3 workers, with sizes not
+// divisible by grain. Sort has to be stable, reduce keeps order of
+// non-commutative op.
+void parallel_algorithms()
+{
+	struct keyed {
+		uint32_t key;
+		uint32_t index;
+	};
+	const size_t sizes[] = {0, 1, 1000, 4099, 100'003};
+	for (size_t workers : {1, 3}) {
+		concurrent::executor ex(workers);
+		for (size_t n : sizes) {
+			std::vector<uint64_t> v(n);
+			for (size_t i = 0; i < n; ++i) {
+				v[i] = checksum(n, i) >> 40;
+			}
+			std::vector<uint64_t> doubled(n);
+			concurrent::parallel_for(ex, 0, n, [&](size_t i) {
+				doubled[i] = v[i] * 2;
+			}).wait();
+			for (size_t i = 0; i < n; ++i) {
+				STRESS_CHECK(doubled[i] == v[i] * 2);
+			}
+
+			STRESS_CHECK(concurrent::parallel_reduce(ex, v.begin(), v.end(),
+													 (uint64_t)7,
+													 std::plus<>())
+							 .get() ==
+						 std::accumulate(v.begin(), v.end(), (uint64_t)7));
+
+			std::vector<uint64_t> scan(n), expected(n);
+			concurrent::parallel_scan(ex, v.begin(), v.end(), scan.begin(),
+									  std::plus<>(), 97)
+				.wait();
+			std::inclusive_scan(v.begin(), v.end(), expected.begin());
+			STRESS_CHECK(scan == expected);
+
+			std::vector<keyed> sorted(n);
+			for (size_t i = 0; i < n; ++i) {
+				sorted[i] = {(uint32_t)(v[i] & 255), (uint32_t)i};
+			}
+			std::vector<keyed> reference = sorted;
+			auto by_key = [](const keyed &a, const keyed &b) {
+				return a.key < b.key;
+			};
+			concurrent::parallel_sort(ex, sorted.begin(), sorted.end(), by_key)
+				.wait();
+			std::stable_sort(reference.begin(), reference.end(), by_key);
+			for (size_t i = 0; i < n; ++i) {
+				STRESS_CHECK(sorted[i].key == reference[i].key &&
+							 sorted[i].index == reference[i].index);
+			}
+		}
+		std::vector<std::string> words;
+		std::string concatenated;
+		for (size_t i = 0; i < 1000; ++i) {
+			words.push_back(std::to_string(i) + ",");
+			concatenated += words.back();
+		}
+		STRESS_CHECK(concurrent::parallel_reduce(ex, words.begin(), words.end(),
+												 std::string("["),
+												 std::plus<>(), 7)
+						 .get() == "[" + concatenated);
+	}
+}
+
+// Throwing func, op or comp in every algorithm and at every stage finishes
+// future with error, executor keeps working afterwards.
+void parallel_throw()
+{
+	const size_t n = 10'000;
+	concurrent::executor ex(3);
+	std::vector<uint64_t> v(n);
+	for (size_t i = 0; i < n; ++i) {
+		v[i] = checksum(n, i) >> 40;
+	}
+	std::vector<uint64_t> out(n);
+	auto failed = [](auto &&f) {
+		f.wait();
+		return !f.has_value();
+	};
+	for (size_t at : {(size_t)0, n / 2, n - 1}) {
+		STRESS_CHECK(failed(concurrent::parallel_for(ex, 0, n, [at](size_t i) {
+			if (i == at) {
+				throw i;
+			}
+		}, 97)));
+
+		size_t calls = 0;
+		auto throwing_plus = [at, &calls](uint64_t a, uint64_t b) {
+			if (std::atomic_ref<size_t>(calls).fetch_add(1) == at) {
+				throw a;
+			}
+			return a + b;
+		};
+		calls = 0;
+		STRESS_CHECK(failed(concurrent::parallel_reduce(
+			ex, v.begin(), v.end(), (uint64_t)0, throwing_plus, 97)));
+		calls = 0;
+		STRESS_CHECK(failed(concurrent::parallel_scan(
+			ex, v.begin(), v.end(), out.begin(), throwing_plus, 97)));
+
+		std::vector<uint64_t> sorted = v;
+		calls = 0;
+		STRESS_CHECK(failed(concurrent::parallel_sort(
+			ex, sorted.begin(), sorted.end(), [at, &calls](uint64_t a, uint64_t b) {
+				if (std::atomic_ref<size_t>(calls).fetch_add(1) == at) {
+					throw a;
+				}
+				return a < b;
+			}, 97)));
+	}
+	STRESS_CHECK(concurrent::parallel_reduce(ex, v.begin(), v.end(),
+											 (uint64_t)7, std::plus<>())
+					 .get() == std::accumulate(v.begin(), v.end(), (uint64_t)7));
+}
+
+// Completion racing with timeout, exactly one of them wins.
+void future_try_fail()
+{
+	const uint64_t rounds = 20'000 * multiplier;
+	uint64_t bad = 0;
+	for (uint64_t r = 0; r < rounds; ++r) {
+		concurrent::promise<uint64_t> p;
+		concurrent::future<uint64_t> f = p.get_future();
+		bool set = false, failed = false;
+		std::thread setter([&]() {
+			jitter();
+			set = p.try_set_value(r);
+		});
+		jitter();
+		failed = f.try_fail();
+		setter.join();
+		f.wait();
+		if (set == failed || f.has_value() != set ||
+			(set && f.get() != r)) {
+			++bad;
+		}
+	}
+	STRESS_CHECK(bad == 0);
+}
+
+// Readers of seqlock thread_safe_value never see torn value.
+void thread_safe_value_seqlock()
+{
+	struct value {
+		uint64_t a, b, c;
+		uint32_t d;
+	};
+	const uint64_t writes = 200'000 * multiplier;
+	concurrent::thread_safe_value<value,
+								  concurrent::thread_safe_value_policy::seqlock>
+		shared(value{0, ~0ull, 0, 0});
+	std::atomic<bool> done = false;
+	std::atomic<uint64_t> torn = 0;
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 2; ++r) {
+		readers.emplace_back([&]() {
+			while (done.load(std::memory_order_relaxed) == false) {
+				const value v = shared;
+				if (v.b != ~v.a || v.c != v.a * 3 || v.d != (uint32_t)v.a) {
+					torn.fetch_add(1, std::memory_order_relaxed);
+				}
+				jitter();
+			}
+		});
+	}
+	for (uint64_t i = 1; i <= writes; ++i) {
+		if (i & 1) {
+			shared = value{i, ~i, i * 3, (uint32_t)i};
+		} else {
+			shared.begin_access();
+			shared->a = i;
+			shared->b = ~i;
+			shared->c = i * 3;
+			shared->d = (uint32_t)i;
+			shared.end_access();
+		}
+		jitter();
+	}
+	done.store(true, std::memory_order_relaxed);
+	for (std::thread &t : readers) {
+		t.join();
+	}
+	STRESS_CHECK(torn.load() == 0);
+	STRESS_CHECK(((value)shared).a == writes);
+}
+
+// Writers replace vector while readers walk snapshots of it, every
+// snapshot has to stay intact until reader drops it.
+void thread_safe_value_rcu()
+{
+	using table = std::vector<uint64_t>;
+	const uint64_t writes = 20'000 * multiplier;
+	concurrent::thread_safe_value<table,
+								  concurrent::thread_safe_value_policy::rcu>
+		shared(table(64, 0));
+	std::atomic<bool> done = false;
+	std::atomic<uint64_t> torn = 0;
+	std::vector<std::thread> threads;
+	for (int r = 0; r < 2; ++r) {
+		threads.emplace_back([&]() {
+			while (done.load(std::memory_order_relaxed) == false) {
+				auto snapshot = shared.read();
+				const uint64_t first = snapshot->front();
+				jitter();
+				for (uint64_t v : *snapshot) {
+					if (v != first) {
+						torn.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			}
+		});
+	}
+	// Second writer modifies in place through begin_access().
+	threads.emplace_back([&]() {
+		for (uint64_t i = 1; i <= writes; ++i) {
+			shared.begin_access();
+			const uint64_t v = shared->front() + 1;
+			for (uint64_t &x : *shared) {
+				x = v;
+			}
+			shared.end_access();
+			jitter();
+		}
+	});
+	for (uint64_t i = 1; i <= writes; ++i) {
+		shared = table(64, i << 32);
+		jitter();
+	}
+	threads.back().join();
+	threads.pop_back();
+	done.store(true, std::memory_order_relaxed);
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	const table last = shared;
+	STRESS_CHECK(torn.load() == 0);
+	STRESS_CHECK(std::accumulate(last.begin(), last.end(), 0ull) ==
+				 last.front() * last.size());
+}
+
+// Increments through apply() combined by other threads, begin_access() and
+// assignments interleaved, none may be lost.
+template <typename Policy> void thread_safe_value_apply()
+{
+	struct counters {
+		uint64_t applied = 0;
+		uint64_t accessed = 0;
+	};
+	const uint64_t per_thread = 50'000 * multiplier;
+	concurrent::thread_safe_value<counters, Policy> shared(counters{});
+	std::atomic<uint64_t> bad = 0;
+	run_producers(per_thread, [&](uint64_t p, uint64_t i) {
+		if (p == 0 && (i & 7) == 0) {
+			shared.begin_access();
+			++shared->accessed;
+			shared.end_access();
+			return;
+		}
+		const uint64_t before = shared.apply([](counters &c) {
+			return c.applied++;
+		});
+		if (before >= per_thread * PRODUCERS) {
+			bad.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+	const counters c = shared;
+	STRESS_CHECK(bad.load() == 0);
+	STRESS_CHECK(c.accessed == per_thread / 8);
+	STRESS_CHECK(c.applied + c.accessed == per_thread * PRODUCERS);
+}
+
+// Threads record scopes, instants and counters while collector drains them
+// into file. Output has to be complete JSON array with one line per event,
+// every written or dropped event accounted, timestamps in microseconds with
+// exactly three decimals, per thread ordered, and names escaped.
+void trace_json()
+{
+	namespace trace = concurrent::trace;
+	const uint64_t per_thread = 2'000 * multiplier;
+	FILE *file = tmpfile();
+	STRESS_CHECK(file != NULL);
+	uint64_t written = 0, dropped = 0;
+	{
+		trace::collector collector(file, concurrent::time::milliseconds(1));
+		run_producers(per_thread, [&](uint64_t p, uint64_t i) {
+			if (i == 0) {
+				trace::set_thread_name(p == 0 ? "quote\"d\n" : "worker");
+			}
+			trace::scope scope("scope");
+			trace::instant("instant");
+			trace::counter("counter", (int64_t)i - 5);
+		});
+		collector.flush();
+		written = collector.count_written_events();
+		dropped = collector.count_dropped_events();
+	}
+	STRESS_CHECK(written + dropped == per_thread * PRODUCERS * 4);
+
+	std::string out;
+	rewind(file);
+	char buf[4096];
+	for (size_t n; (n = fread(buf, 1, sizeof(buf), file)) > 0;) {
+		out.append(buf, n);
+	}
+	fclose(file);
+	const std::string header =
+		"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	STRESS_CHECK(out.compare(0, header.size(), header) == 0);
+	STRESS_CHECK(out.size() >= 4 &&
+				 out.compare(out.size() - 4, 4, "\n]}\n") == 0);
+	STRESS_CHECK(out.find("\"name\":\"quote\\\"d\\u000a\"") != std::string::npos);
+	STRESS_CHECK(out.find("\"args\":{\"value\":-5}") != std::string::npos);
+
+	// tid -> last timestamp in ns and depth of open scopes.
+	std::vector<int64_t> last_ts, depth;
+	uint64_t events = 0;
+	bool ok = true;
+	size_t pos = header.size();
+	for (size_t end; (end = out.find('\n', pos)) != std::string::npos;
+		 pos = end + 1) {
+		std::string line = out.substr(pos, end - pos);
+		if (line == "]}") {
+			break;
+		}
+		if (line.back() == ',') {
+			line.pop_back();
+		}
+		unsigned tid = 0;
+		char phase = 0;
+		const size_t ph = line.find("\"ph\":\"");
+		const size_t t = line.find("\"tid\":");
+		if (line.front() != '{' || line.back() != '}' ||
+			ph == std::string::npos || t == std::string::npos) {
+			ok = false;
+			break;
+		}
+		phase = line[ph + 6];
+		tid = strtoul(line.c_str() + t + 6, NULL, 10);
+		if (phase == 'M') {
+			continue;
+		}
+		++events;
+		const size_t ts = line.find("\"ts\":");
+		const char *num = line.c_str() + ts + 5;
+		const bool negative = *num == '-';
+		char *dot = NULL;
+		const int64_t us = strtoll(num + negative, &dot, 10);
+		ok &= ts != std::string::npos && *dot == '.' &&
+			  strspn(dot + 1, "0123456789") == 3 && dot[4] == ',';
+		const int64_t ns =
+			(negative ? -1 : 1) * (us * 1000 + strtoll(dot + 1, NULL, 10));
+		if (tid >= last_ts.size()) {
+			last_ts.resize(tid + 1, INT64_MIN);
+			depth.resize(tid + 1, 0);
+		}
+		ok &= ns >= last_ts[tid];
+		last_ts[tid] = ns;
+		depth[tid] += phase == 'B' ? 1 : phase == 'E' ? -1 : 0;
+		ok &= depth[tid] >= 0 || dropped > 0;
+	}
+	STRESS_CHECK(ok);
+	STRESS_CHECK(events == written);
+	for (int64_t d : depth) {
+		STRESS_CHECK(d == 0 || dropped > 0);
+	}
+}
+
+// stat_lock_guard has to keep exclusion of lock it wraps and, when
+// compiled with CONCURRENT_CONTENTION_STATS, count every acquisition.
+// Disabled counters report zeros.
+template <typename Lock> void contention_stats()
+{
+	const uint64_t per_thread = 50'000 * multiplier;
+	Lock lock;
+	concurrent::contention_counters counters;
+	uint64_t counter = 0;
+	run_producers(per_thread, [&](uint64_t, uint64_t) {
+		concurrent::stat_lock_guard guard(lock, counters);
+		const uint64_t v = counter;
+		jitter();
+		counter = v + 1;
+	});
+	STRESS_CHECK(counter == per_thread * PRODUCERS);
+	const concurrent::contention_snapshot s = counters.snapshot();
+	if constexpr (concurrent::contention_counters::enabled) {
+		STRESS_CHECK(s.lock_acquisitions == counter);
+		STRESS_CHECK(s.lock_contended <= s.lock_acquisitions);
+		STRESS_CHECK(s.lock_wait.ns >= 0 && s.lock_hold.ns >= 0);
+		STRESS_CHECK(s.lock_contended > 0 || s.lock_wait.ns == 0);
+	} else {
+		STRESS_CHECK(s.lock_acquisitions == 0 && s.lock_contended == 0);
+		STRESS_CHECK(s.lock_wait.ns == 0 && s.lock_hold.ns == 0);
+	}
+	counters.reset();
+	STRESS_CHECK(counters.snapshot().lock_acquisitions == 0);
+}
+
+// Plain counter guarded by lock, taken with lock() and try_lock(), every
+// increment has to survive.
+template <typename Lock> void lock_exclusion()
+{
+	const uint64_t per_thread = 100'000 * multiplier;
+	Lock lock;
+	uint64_t counter = 0;
+	run_producers(per_thread, [&](uint64_t p, uint64_t i) {
+		if ((i + p) & 1) {
+			lock.lock();
+		} else {
+			while (lock.try_lock() == false) {
+				jitter();
+			}
+		}
+		const uint64_t v = counter;
+		jitter();
+		counter = v + 1;
+		lock.unlock();
+	});
+	STRESS_CHECK(counter == per_thread * PRODUCERS);
+}
+
+struct test {
+	const char *name;
+	void (*func)();
+};
+
+const test tests[] = {
+	{"mpsc_stack/exponential", mpsc_stack<concurrent::exponential_backoff>},
+	{"mpsc_stack/none", mpsc_stack<concurrent::no_backoff>},
+	{"mpsc_stack/spin_then_yield",
+	 mpsc_stack<concurrent::spin_then_yield_backoff>},
+	{"mpsc_stack/randomized", mpsc_stack<concurrent::randomized_backoff>},
+	{"mpsc_queue", mpsc_queue},
+	{"mpmc_elimination/exponential",
+	 mpmc_stack_elimination<concurrent::exponential_backoff>},
+	{"mpmc_elimination/none", mpmc_stack_elimination<concurrent::no_backoff>},
+	{"mpmc_elimination/spin_then_yield",
+	 mpmc_stack_elimination<concurrent::spin_then_yield_backoff>},
+	{"mpmc_elimination/randomized",
+	 mpmc_stack_elimination<concurrent::randomized_backoff>},
+	{"mpmc_elimination/reoffer", elimination_reoffer},
+	{"bucket_pool_trim", bucket_pool_trim},
+	{"bucket_pool_refill", bucket_pool_refill},
+	{"numa_pool_steal", numa_pool_steal},
+	{"object_pool_handles", object_pool_handles},
+	{"spsc_ringbuffer", spsc_ringbuffer},
+	{"broadcast_ring/single_blocking",
+	 broadcast_ring<concurrent::broadcast::single_producer,
+					concurrent::broadcast::blocking_wait>},
+	{"broadcast_ring/multi_yielding",
+	 broadcast_ring<concurrent::broadcast::multi_producer,
+					concurrent::broadcast::yielding_wait>},
+	{"pipeline", pipeline},
+	{"future_continuations", future_continuations},
+	{"future_refcount", future_refcount},
+	{"future_when_all_any", future_when_all_any},
+	{"futex_timed_wait", futex_timed_wait},
+	{"future_try_fail", future_try_fail},
+	{"run_loop_until", run_loop_until},
+	{"time_now_fast", time_now_fast},
+	{"timer_wheel_fire_cancel", timer_wheel_fire_cancel},
+	{"latency_histogram_bounds", latency_histogram_bounds},
+	{"trace_json", trace_json},
+	{"spmc_deque", spmc_deque},
+	{"executor_pending", executor_pending},
+	{"executor_throw", executor_throw},
+	{"executor_steal", executor_steal},
+	{"parallel_algorithms", parallel_algorithms},
+	{"parallel_throw", parallel_throw},
+	{"coroutine_task", coroutine_task},
+	{"thread_safe_value_seqlock", thread_safe_value_seqlock},
+	{"thread_safe_value_rcu", thread_safe_value_rcu},
+	{"apply/mutex",
+	 thread_safe_value_apply<concurrent::thread_safe_value_policy::mutex>},
+	{"apply/seqlock",
+	 thread_safe_value_apply<concurrent::thread_safe_value_policy::seqlock>},
+	{"apply/rcu",
+	 thread_safe_value_apply<concurrent::thread_safe_value_policy::rcu>},
+	{"contention/mutex", contention_stats<std::mutex>},
+	{"contention/hybrid_mutex", contention_stats<concurrent::hybrid_mutex>},
+	{"lock/ttas_spinlock", lock_exclusion<concurrent::ttas_spinlock>},
+	{"lock/ticket_lock", lock_exclusion<concurrent::ticket_lock>},
+	{"lock/hybrid_mutex", lock_exclusion<concurrent::hybrid_mutex>},
+};
+} // namespace
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) {
+		multiplier = strtoull(argv[1], NULL, 10);
+		multiplier = multiplier ? multiplier : 1;
+	}
+	for (const test &t : tests) {
+		const int before = failures;
+		const concurrent::time::point start = concurrent::time::now();
+		t.func();
+		printf("%-32s %-6s %8.3f s\n", t.name,
+			   failures == before ? "ok" : "FAILED",
+			   (concurrent::time::now() - start).ns / 1e9);
+	}
+	return failures ? 1 : 0;
+}
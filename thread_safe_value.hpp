@@ -6,74 +6,426 @@
 #ifndef CONCURRECT_THREAD_SAFE_VALUE_HPP
 #define CONCURRECT_THREAD_SAFE_VALUE_HPP
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <exception>
+#include <functional>
 #include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "rcu.hpp"
 
 namespace concurrent {
-template <typename T> class thread_safe_value
+//	Selects how thread_safe_value synchronizes readers with writers. Writers
+//	(assignment and begin_access()..end_access()) are always serialized by
+//	Lock (std::mutex or any of locks.hpp).
+namespace thread_safe_value_policy
+{
+//	Every read copies value under mutex.
+struct mutex {
+};
+
+//	Readers copy value optimistically and retry only when it was written
+//	concurrently, they never write shared memory so reads scale with number
+//	of threads. Requires trivially copyable T.
+struct seqlock {
+};
+
+//	Read-copy-update for large T read far more often than written. Writer
+//	publishes new heap allocated version, readers take lock-free snapshot
+//	through read() (or copy as with other policies) and old versions are
+//	freed once no reader holds them. begin_access() copies current version
+//	for modification.
+struct rcu {
+};
+
+template <typename T>
+using automatic = std::conditional_t<std::is_trivially_copyable_v<T>, seqlock,
+									 mutex>;
+} // namespace thread_safe_value_policy
+
+namespace detail
+{
+template <typename T, typename Policy, typename Lock> class thread_safe_storage;
+
+template <typename T, typename Lock>
+class thread_safe_storage<T, thread_safe_value_policy::mutex, Lock>
+{
+public:
+	thread_safe_storage() = default;
+	template <typename V> thread_safe_storage(V &&v) : value(std::forward<V>(v))
+	{
+	}
+
+	T load() const
+	{
+		std::lock_guard lock(mutex);
+		return value;
+	}
+
+	template <typename V> void store(V &&v)
+	{
+		std::lock_guard lock(mutex);
+		value = std::forward<V>(v);
+	}
+
+	void lock() { mutex.lock(); }
+	bool try_lock() { return mutex.try_lock(); }
+	void unlock() { mutex.unlock(); }
+	T &ref() { return value; }
+
+private:
+	mutable Lock mutex;
+	T value;
+};
+
+//	Writer keeps its own copy of value, which access() exposes between
+//	lock() and unlock(), and publishes it into words as 64 bit relaxed
+//	atomics between two increments of seq. Reader copies words and accepts
+//	the copy when seq was even and unchanged around it.
+template <typename T, typename Lock>
+class thread_safe_storage<T, thread_safe_value_policy::seqlock, Lock>
+{
+public:
+	static_assert(std::is_trivially_copyable_v<T>,
+				  "seqlock thread_safe_value requires trivially copyable T");
+
+	thread_safe_storage() : value() { _internal_publish(); }
+	template <typename V> thread_safe_storage(V &&v) : value(std::forward<V>(v))
+	{
+		_internal_publish();
+	}
+
+	T load() const
+	{
+		for (;;) {
+			const uint64_t s = seq.load(std::memory_order_acquire);
+			if (s & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::array<unsigned char, sizeof(T)> bytes;
+			for (size_t i = 0; i < WORDS; ++i) {
+				const uint64_t w = words[i].load(std::memory_order_relaxed);
+				const size_t n = i + 1 < WORDS ? 8 : sizeof(T) - i * 8;
+				memcpy(bytes.data() + i * 8, &w, n);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq.load(std::memory_order_relaxed) == s) {
+				return std::bit_cast<T>(bytes);
+			}
+		}
+	}
+
+	template <typename V> void store(V &&v)
+	{
+		std::lock_guard lock(mutex);
+		value = std::forward<V>(v);
+		_internal_publish();
+	}
+
+	void lock() { mutex.lock(); }
+	bool try_lock() { return mutex.try_lock(); }
+	void unlock()
+	{
+		_internal_publish();
+		mutex.unlock();
+	}
+	T &ref() { return value; }
+
+private:
+	static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+
+	void _internal_publish()
+	{
+		uint64_t tmp[WORDS] = {};
+		memcpy(tmp, &value, sizeof(T));
+		const uint64_t s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < WORDS; ++i) {
+			words[i].store(tmp[i], std::memory_order_relaxed);
+		}
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+private:
+	std::atomic<uint64_t> seq = 0;
+	std::atomic<uint64_t> words[WORDS];
+	Lock mutex;
+	T value;
+};
+
+//	Versions replaced by writers wait in retired until rcu reports that no
+//	reader can still see them, reclamation is attempted on every write so it
+//	never blocks writer on readers.
+template <typename T, typename Lock>
+class thread_safe_storage<T, thread_safe_value_policy::rcu, Lock>
+{
+public:
+	//	Reference to version current at time of read(), valid for lifetime of
+	//	snapshot, which can not leave creating thread. Holding snapshot
+	//	delays reclamation of replaced versions.
+	class snapshot
+	{
+	public:
+		const T &operator*() const { return *value; }
+		const T *operator->() const { return value; }
+		const T &get() const { return *value; }
+
+	private:
+		friend class thread_safe_storage;
+		snapshot(const std::atomic<const T *> &current)
+			: value(current.load(std::memory_order_acquire))
+		{
+		}
+
+		rcu::read_guard guard;
+		const T *value;
+	};
+
+	thread_safe_storage() : current(new T()) {}
+	template <typename V>
+	thread_safe_storage(V &&v) : current(new T(std::forward<V>(v)))
+	{
+	}
+	//	No snapshot may be held at destruction.
+	~thread_safe_storage()
+	{
+		if (retired.empty() == false) {
+			rcu::synchronize();
+			_internal_reclaim();
+		}
+		delete current.load(std::memory_order_relaxed);
+	}
+
+	snapshot read() const { return snapshot(current); }
+
+	T load() const { return *read(); }
+
+	template <typename V> void store(V &&v)
+	{
+		T *n = new T(std::forward<V>(v));
+		std::lock_guard lock(mutex);
+		_internal_publish(n);
+	}
+
+	void lock()
+	{
+		mutex.lock();
+		pending = new T(*current.load(std::memory_order_relaxed));
+	}
+	bool try_lock()
+	{
+		if (mutex.try_lock() == false) {
+			return false;
+		}
+		pending = new T(*current.load(std::memory_order_relaxed));
+		return true;
+	}
+	void unlock()
+	{
+		_internal_publish(pending);
+		pending = NULL;
+		mutex.unlock();
+	}
+	//	Copy being modified exists only between lock() and unlock(), aborts
+	//	when called outside of them.
+	T &ref()
+	{
+		if (pending == NULL) {
+			abort();
+		}
+		return *pending;
+	}
+
+private:
+	void _internal_publish(T *n)
+	{
+		const T *old = current.exchange(n, std::memory_order_acq_rel);
+		retired.push_back({old, rcu::retire_epoch()});
+		_internal_reclaim();
+	}
+
+	void _internal_reclaim()
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < retired.size(); ++i) {
+			if (rcu::is_quiescent(retired[i].second)) {
+				delete retired[i].first;
+			} else {
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+	}
+
+private:
+	std::atomic<const T *> current;
+	Lock mutex;
+	//	Guarded by mutex.
+	T *pending = NULL;
+	std::vector<std::pair<const T *, uint64_t>> retired;
+};
+
+//	Operation of thread_safe_value::apply() published for combiner, lives on
+//	stack of publishing thread until done is set.
+struct combining_request {
+	void (*run)(combining_request *self, void *value);
+	std::exception_ptr error;
+	std::atomic<bool> done = false;
+};
+
+template <typename T, typename F, typename R>
+struct typed_combining_request : combining_request {
+	typed_combining_request(F &f) : f(f)
+	{
+		run = [](combining_request *self, void *value) {
+			typed_combining_request *r = (typed_combining_request *)self;
+			try {
+				if constexpr (std::is_void_v<R>) {
+					std::invoke(r->f, *(T *)value);
+				} else {
+					r->result.emplace(std::invoke(r->f, *(T *)value));
+				}
+			} catch (...) {
+				r->error = std::current_exception();
+			}
+		};
+	}
+
+	F &f;
+	std::optional<std::conditional_t<std::is_void_v<R>, int, R>> result;
+};
+
+//	Publication slots of flat combining, one per thread index.
+struct combining_slots {
+	static constexpr size_t SLOTS = 64;
+
+	struct alignas(64) slot {
+		std::atomic<combining_request *> request = NULL;
+	};
+
+	slot slots[SLOTS];
+};
+
+//	Claims free slot index for lifetime of thread, shared by all
+//	thread_safe_value instances. Threads beyond SLOTS get NO_SLOT and apply()
+//	directly under lock.
+struct combining_thread_slot {
+	static constexpr size_t NO_SLOT = combining_slots::SLOTS;
+
+	combining_thread_slot()
+	{
+		uint64_t mask = owned_mask().load(std::memory_order_relaxed);
+		while (~mask != 0) {
+			const size_t i = __builtin_ctzll(~mask);
+			if (owned_mask().compare_exchange_weak(mask,
+												   mask | (uint64_t(1) << i),
+												   std::memory_order_relaxed)) {
+				index = i;
+				return;
+			}
+		}
+	}
+	~combining_thread_slot()
+	{
+		if (index != NO_SLOT) {
+			owned_mask().fetch_and(~(uint64_t(1) << index),
+								   std::memory_order_relaxed);
+		}
+	}
+
+	//	Combiner scans only slots of live threads.
+	static std::atomic<uint64_t> &owned_mask()
+	{
+		static std::atomic<uint64_t> mask = 0;
+		return mask;
+	}
+
+	static inline size_t get()
+	{
+		thread_local combining_thread_slot slot;
+		return slot.index;
+	}
+
+	size_t index = NO_SLOT;
+};
+} // namespace detail
+
+//	Value guarded for concurrent reads and writes. Conversion to T returns
+//	copy, assignment replaces value, begin_access()/end_access() bracket
+//	in-place modification through access() and apply() runs function on
+//	value under flat combining. See thread_safe_value_policy for Policy, by
+//	default trivially copyable T uses seqlock.
+template <typename T,
+		  typename Policy = thread_safe_value_policy::automatic<T>,
+		  typename Lock = std::mutex>
+class thread_safe_value
 {
 public:
 	thread_safe_value() = default;
+	~thread_safe_value() { delete combining.load(std::memory_order_relaxed); }
 
-	thread_safe_value(T &&v) : value(std::move(v)) {}
-	thread_safe_value(T &v) : value(v) {}
-	thread_safe_value(const T &v) : value(v) {}
+	thread_safe_value(T &&v) : storage(std::move(v)) {}
+	thread_safe_value(T &v) : storage(v) {}
+	thread_safe_value(const T &v) : storage(v) {}
 
-	thread_safe_value(const thread_safe_value<T> &o) { value = o; }
+	thread_safe_value(const thread_safe_value &o) : storage(o.load()) {}
 
-	thread_safe_value &operator=(const thread_safe_value<T> &o)
+	thread_safe_value &operator=(const thread_safe_value &o)
 	{
-		T v = o;
-		*this = (T)v;
+		storage.store(o.load());
 		return *this;
 	}
 
-	thread_safe_value(thread_safe_value<T> &o) { value = (T)o; }
+	thread_safe_value(thread_safe_value &o) : storage(o.load()) {}
 
-	thread_safe_value &operator=(thread_safe_value<T> &o)
+	thread_safe_value &operator=(thread_safe_value &o)
 	{
-		T v = o;
-		*this = (T)v;
+		storage.store(o.load());
 		return *this;
 	}
 
 	thread_safe_value &operator=(T &v)
 	{
-		std::lock_guard lock(mutex);
-		value = v;
+		storage.store(v);
 		return *this;
 	}
 	thread_safe_value &operator=(const T &v)
 	{
-		std::lock_guard lock(mutex);
-		value = v;
+		storage.store(v);
 		return *this;
 	}
 
-	operator T()
-	{
-		T ret;
-		{
-			std::lock_guard lock(mutex);
-			ret = value;
-		}
-		return ret;
-	}
+	T load() const { return storage.load(); }
 
-	operator T() const
+	//	Lock-free reference to current value, only with rcu policy.
+	auto read() const
+		requires std::is_same_v<Policy, thread_safe_value_policy::rcu>
 	{
-		T ret;
-		{
-			std::lock_guard lock(*(std::mutex *)&mutex);
-			ret = value;
-		}
-		return ret;
+		return storage.read();
 	}
 
-	template <typename T2> thread_safe_value(thread_safe_value<T2> &o)
+	operator T() { return storage.load(); }
+
+	operator T() const { return storage.load(); }
+
+	template <typename T2, typename P2, typename L2>
+	thread_safe_value(thread_safe_value<T2, P2, L2> &o) : storage((T)(T2)o)
 	{
-		value = (T)o;
 	}
-	template <typename T2> thread_safe_value &operator=(thread_safe_value<T2> &o)
+	template <typename T2, typename P2, typename L2>
+	thread_safe_value &operator=(thread_safe_value<T2, P2, L2> &o)
 	{
 		T2 v = o;
 		*this = (T)v;
@@ -82,45 +434,134 @@ public:
 
 	template <typename T2> thread_safe_value &operator=(T2 &v)
 	{
-		std::lock_guard lock(mutex);
-		value = v;
+		storage.lock();
+		storage.ref() = v;
+		storage.unlock();
 		return *this;
 	}
 
-	template <typename T2> operator T2()
+	template <typename T2> operator T2() { return storage.load(); }
+
+	template <typename T2> operator T2() const { return storage.load(); }
+
+	//	Changes made through access() become visible to readers in
+	//	end_access(). access(), operator-> and operator* are valid only
+	//	between begin_access() and end_access(), with rcu policy they abort
+	//	outside of them as there is no private copy to return.
+	void begin_access() { storage.lock(); }
+	bool try_begin_access() { return storage.try_lock(); }
+	void end_access() { storage.unlock(); }
+	T &access() { return storage.ref(); }
+	T *operator->() { return &storage.ref(); }
+	T &operator*() { return storage.ref(); }
+
+	//	Returns f(T&) run with exclusive access to value. Instead of each
+	//	thread taking lock in turn, callers publish f into per-thread slot
+	//	and whichever of them gets the lock runs whole batch of published
+	//	operations (flat combining), so value stays in cache of one core and
+	//	lock is not bounced between cores under contention. f may run on
+	//	another thread, exceptions are rethrown in caller. Mixes freely with
+	//	begin_access() and assignments, with seqlock and rcu policies one
+	//	publication covers whole batch.
+	template <typename F> auto apply(F &&f) -> std::invoke_result_t<F &, T &>
 	{
-		T ret;
-		{
-			std::lock_guard lock(mutex);
-			ret = value;
+		using R = std::invoke_result_t<F &, T &>;
+		static_assert(!std::is_reference_v<R>,
+					  "apply() result can not reference guarded value");
+		// Uncontended, run f directly and serve whoever published meanwhile.
+		if (storage.try_lock()) {
+			unlock_guard guard{storage};
+			if (combining.load(std::memory_order_relaxed) != NULL) {
+				_internal_combine();
+			}
+			return std::invoke(f, storage.ref());
+		}
+		const size_t index = detail::combining_thread_slot::get();
+		if (index == detail::combining_thread_slot::NO_SLOT) {
+			storage.lock();
+			unlock_guard guard{storage};
+			return std::invoke(f, storage.ref());
+		}
+		detail::typed_combining_request<T, F, R> request(f);
+		std::atomic<detail::combining_request *> &slot =
+			_internal_combining_slots()->slots[index].request;
+		slot.store(&request, std::memory_order_release);
+		while (request.done.load(std::memory_order_acquire) == false) {
+			if (storage.try_lock()) {
+				_internal_combine();
+				storage.unlock();
+			} else {
+				std::this_thread::yield();
+			}
+		}
+		if (request.error) {
+			std::rethrow_exception(request.error);
+		}
+		if constexpr (!std::is_void_v<R>) {
+			return std::move(*request.result);
 		}
-		return ret;
 	}
 
-	template <typename T2> operator T2() const
+private:
+	struct unlock_guard {
+		detail::thread_safe_storage<T, Policy, Lock> &s;
+		~unlock_guard() { s.unlock(); }
+	};
+
+	//	Called with lock held. Runs published requests, own one included,
+	//	repeating while new ones keep arriving up to COMBINE_PASSES.
+	void _internal_combine()
 	{
-		T ret;
-		{
-			std::lock_guard lock(*(std::mutex *)&mutex);
-			ret = value;
+		static constexpr int COMBINE_PASSES = 3;
+		detail::combining_slots *s = combining.load(std::memory_order_acquire);
+		T &value = storage.ref();
+		for (int pass = 0; pass < COMBINE_PASSES; ++pass) {
+			bool any = false;
+			uint64_t mask = detail::combining_thread_slot::owned_mask().load(
+				std::memory_order_relaxed);
+			for (; mask; mask &= mask - 1) {
+				std::atomic<detail::combining_request *> &slot =
+					s->slots[__builtin_ctzll(mask)].request;
+				if (slot.load(std::memory_order_relaxed) == NULL) {
+					continue;
+				}
+				detail::combining_request *r =
+					slot.exchange(NULL, std::memory_order_acquire);
+				if (r != NULL) {
+					r->run(r, &value);
+					r->done.store(true, std::memory_order_release);
+					any = true;
+				}
+			}
+			if (any == false) {
+				break;
+			}
 		}
-		return ret;
 	}
 
-	void begin_access() { mutex.lock(); }
-	bool try_begin_access() { return mutex.try_lock(); }
-	void end_access() { mutex.unlock(); }
-	T &access() { return value; }
-	T *operator->() { return &value; }
-	T &operator*() { return value; }
+	detail::combining_slots *_internal_combining_slots()
+	{
+		detail::combining_slots *s = combining.load(std::memory_order_acquire);
+		if (s != NULL) {
+			return s;
+		}
+		detail::combining_slots *n = new detail::combining_slots();
+		if (combining.compare_exchange_strong(s, n, std::memory_order_acq_rel,
+											  std::memory_order_acquire)) {
+			return n;
+		}
+		delete n;
+		return s;
+	}
 
 private:
 	thread_safe_value(thread_safe_value &&) = delete;
 	thread_safe_value &operator=(thread_safe_value &&) = delete;
 
 private:
-	std::mutex mutex;
-	T value;
+	detail::thread_safe_storage<T, Policy, Lock> storage;
+	//	Allocated on first apply().
+	std::atomic<detail::combining_slots *> combining = NULL;
 };
 }
 
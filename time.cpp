@@ -6,8 +6,15 @@
 #ifndef CONCURRECT_TIME_CPP
 #define CONCURRECT_TIME_CPP
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 #include "time.hpp"
 
@@ -25,6 +32,284 @@ void sleep_for(diff dt)
 {
 	std::this_thread::sleep_for(std::chrono::nanoseconds(dt.ns));
 }
+
+namespace detail
+{
+fast_clock_params fast_clock;
+std::atomic<int64_t> coarse_clock_ns = 0;
+} // namespace detail
+
+namespace
+{
+struct tick_sample {
+	uint64_t ticks;
+	int64_t ns;
+};
+
+// Brackets now() between two counter reads and keeps the tightest of few
+// tries, so preemption or vDSO hiccup does not skew the pair.
+tick_sample sample_ticks()
+{
+	tick_sample best{0, 0};
+	uint64_t best_window = ~(uint64_t)0;
+	for (int i = 0; i < 8; ++i) {
+		const uint64_t a = detail::read_ticks();
+		const int64_t ns = now().ns;
+		const uint64_t b = detail::read_ticks();
+		if (b - a < best_window) {
+			best_window = b - a;
+			best = {a + (b - a) / 2, ns};
+		}
+	}
+	return best;
+}
+
+bool detect_fast_clock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned eax, ebx, ecx, edx;
+	if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+		eax < 0x80000007) {
+		return false;
+	}
+	__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+	// Invariant TSC: constant rate across P-, C- and T-states.
+	return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+struct fast_clock_calibration {
+	std::mutex mutex;
+	std::once_flag once;
+	std::atomic<bool> unsupported = false;
+	// First sample, every recalibration measures rate over whole window since
+	// then so the error of single sample shrinks with uptime.
+	tick_sample anchor{0, 0};
+
+	void publish(int64_t base_ns, uint64_t base_ticks, uint64_t mult)
+	{
+		detail::fast_clock_params &c = detail::fast_clock;
+		const uint32_t seq = c.seq.load(std::memory_order_relaxed);
+		c.seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		c.base_ns.store(base_ns, std::memory_order_relaxed);
+		c.base_ticks.store(base_ticks, std::memory_order_relaxed);
+		c.mult.store(mult, std::memory_order_relaxed);
+		c.seq.store(seq + 2, std::memory_order_release);
+	}
+
+	static uint64_t compute_mult(tick_sample from, tick_sample to)
+	{
+		if (to.ticks <= from.ticks || to.ns <= from.ns) {
+			return 0;
+		}
+		return (uint64_t)(((unsigned __int128)(to.ns - from.ns) << 32) /
+						  (to.ticks - from.ticks));
+	}
+
+	void calibrate()
+	{
+		if (detect_fast_clock() == false) {
+			unsupported.store(true, std::memory_order_relaxed);
+			return;
+		}
+		std::lock_guard lock(mutex);
+		anchor = sample_ticks();
+		tick_sample end;
+		do {
+			end = sample_ticks();
+		} while (end.ns - anchor.ns < 2'000'000);
+		const uint64_t mult = compute_mult(anchor, end);
+		if (mult == 0) {
+			unsupported.store(true, std::memory_order_relaxed);
+			return;
+		}
+		publish(end.ns, end.ticks, mult);
+	}
+
+	void recalibrate(diff slew_window)
+	{
+		if (unsupported.load(std::memory_order_relaxed)) {
+			return;
+		}
+		std::lock_guard lock(mutex);
+		detail::fast_clock_params &c = detail::fast_clock;
+		if (c.mult.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+		const tick_sample s = sample_ticks();
+		const uint64_t mult = compute_mult(anchor, s);
+		if (mult == 0) {
+			return;
+		}
+		// Never move backwards: if the old rate ran ahead of steady_clock keep
+		// its value at this point and slow the new rate down. Like adjtime()
+		// the rate is changed by at most MAX_SLEW_PPM, so big offset is
+		// absorbed over several windows instead of halving clock speed.
+		const int64_t projected =
+			c.base_ns.load(std::memory_order_relaxed) +
+			(int64_t)(((__int128)(int64_t)(s.ticks -
+										   c.base_ticks.load(
+											   std::memory_order_relaxed)) *
+					   c.mult.load(std::memory_order_relaxed)) >>
+					  32);
+		const int64_t ahead = projected - s.ns;
+		if (ahead <= 0 || slew_window.ns <= 0) {
+			publish(s.ns, s.ticks, mult);
+			return;
+		}
+		const int64_t absorbed =
+			std::min(ahead, slew_window.ns / 1'000'000 * MAX_SLEW_PPM);
+		const uint64_t slewed = (uint64_t)(
+			((unsigned __int128)mult * (uint64_t)(slew_window.ns - absorbed)) /
+			(uint64_t)slew_window.ns);
+		publish(projected, s.ticks, slewed);
+	}
+
+	static constexpr int64_t MAX_SLEW_PPM = 500;
+};
+
+fast_clock_calibration &calibration()
+{
+	static fast_clock_calibration c;
+	return c;
+}
+
+struct background_clock {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::thread thread;
+	// Incremented by halt(), each thread runs only within its generation.
+	uint64_t generation = 0;
+	diff coarse_period = milliseconds(1);
+	diff recalibration_period = seconds(1);
+
+	~background_clock()
+	{
+		halt();
+		detail::coarse_clock_ns.store(-1, std::memory_order_relaxed);
+	}
+
+	// Negative periods keep previous configuration.
+	void start(diff coarse, diff recalibration)
+	{
+		std::unique_lock lock(mutex);
+		if (coarse.ns >= 0) {
+			coarse_period = max(coarse, microseconds(10));
+		}
+		if (recalibration.ns >= 0) {
+			recalibration_period = recalibration;
+		}
+		if (thread.joinable()) {
+			cv.notify_all();
+			return;
+		}
+		detail::coarse_clock_ns.store(now().ns, std::memory_order_relaxed);
+		thread = std::thread([this, gen = generation]() { run(gen); });
+	}
+
+	void halt()
+	{
+		std::thread t;
+		{
+			std::lock_guard lock(mutex);
+			++generation;
+			t = std::move(thread);
+		}
+		cv.notify_all();
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+
+	void run(uint64_t gen)
+	{
+		std::unique_lock lock(mutex);
+		point next_recalibration = now() + recalibration_period;
+		while (gen == generation) {
+			const point t = now();
+			detail::coarse_clock_ns.store(t.ns, std::memory_order_relaxed);
+			if (recalibration_period.ns > 0 && t >= next_recalibration) {
+				lock.unlock();
+				calibration().recalibrate(recalibration_period);
+				lock.lock();
+				next_recalibration = now() + recalibration_period;
+				continue;
+			}
+			cv.wait_for(lock, std::chrono::nanoseconds(coarse_period.ns));
+		}
+	}
+};
+
+background_clock &background()
+{
+	// Background thread uses calibration, so it has to outlive this one.
+	calibration();
+	static background_clock b;
+	return b;
+}
+} // namespace
+
+namespace detail
+{
+point _internal_fast_clock_slow_path()
+{
+	fast_clock_calibration &c = calibration();
+	if (c.unsupported.load(std::memory_order_relaxed) == false) {
+		std::call_once(c.once, [&c]() { c.calibrate(); });
+		if (coarse_clock_ns.load(std::memory_order_relaxed) == 0) {
+			start_background_clock();
+		}
+		if (c.unsupported.load(std::memory_order_relaxed) == false) {
+			return now_fast();
+		}
+	}
+	return now();
+}
+
+point _internal_coarse_clock_slow_path()
+{
+	if (coarse_clock_ns.load(std::memory_order_relaxed) == 0) {
+		start_background_clock();
+	}
+	return now();
+}
+} // namespace detail
+
+void start_background_clock(diff coarse_period, diff recalibration_period)
+{
+	background().start(coarse_period, recalibration_period);
+}
+
+void start_background_clock()
+{
+	background().start({-1}, {-1});
+}
+
+void stop_background_clock()
+{
+	background().halt();
+	detail::coarse_clock_ns.store(-1, std::memory_order_relaxed);
+}
+
+void recalibrate_fast_clock()
+{
+	if (detail::fast_clock.mult.load(std::memory_order_relaxed) == 0) {
+		now_fast();
+	} else {
+		calibration().recalibrate(seconds(1));
+	}
+}
+
+bool has_fast_clock()
+{
+	now_fast();
+	return calibration().unsupported.load(std::memory_order_relaxed) == false;
+}
 } // namespace time
 } // namespace concurrent
 
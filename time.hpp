@@ -7,6 +7,13 @@
 #define CONCURRECT_TIME_HPP
 
 #include <cstdint>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define CONCURRENT_TIME_HAS_TICKS 1
+#else
+#define CONCURRENT_TIME_HAS_TICKS 0
+#endif
 
 namespace concurrent
 {
@@ -32,6 +39,99 @@ struct point {
 point now();
 void sleep_for(diff dt);
 
+namespace detail
+{
+// Conversion from hardware ticks to steady_clock nanoseconds:
+//   ns = base_ns + ((ticks - base_ticks) * mult) >> 32
+// Guarded by seq (seqlock, odd while being rewritten). mult == 0 means not
+// calibrated yet.
+struct fast_clock_params {
+	alignas(64) std::atomic<uint32_t> seq;
+	std::atomic<int64_t> base_ns;
+	std::atomic<uint64_t> base_ticks;
+	std::atomic<uint64_t> mult;
+};
+extern fast_clock_params fast_clock;
+
+// Cached value of now() refreshed by background thread. 0 means that thread
+// is not running yet, negative means it was stopped and now_coarse() should
+// fall back to now().
+extern std::atomic<int64_t> coarse_clock_ns;
+
+point _internal_fast_clock_slow_path();
+point _internal_coarse_clock_slow_path();
+
+inline uint64_t read_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+	uint64_t v;
+	asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+	return v;
+#else
+	return 0;
+#endif
+}
+} // namespace detail
+
+// Inline timestamp from invariant TSC (or cntvct_el0 on aarch64), scaled to
+// the same epoch and units as now(). Calibrated against steady_clock on first
+// use and periodically corrected for drift by background clock thread. Falls
+// back to now() when the cpu has no usable constant rate counter. First call
+// blocks for about 2 ms while calibrating and starts background clock thread
+// (waking every 1 ms), call start_background_clock() and
+// recalibrate_fast_clock() up front to keep that off latency sensitive paths.
+inline point now_fast()
+{
+#if CONCURRENT_TIME_HAS_TICKS
+	detail::fast_clock_params &c = detail::fast_clock;
+	for (;;) {
+		const uint32_t seq = c.seq.load(std::memory_order_acquire);
+		const uint64_t mult = c.mult.load(std::memory_order_relaxed);
+		if (mult == 0) {
+			return detail::_internal_fast_clock_slow_path();
+		}
+		const int64_t base_ns = c.base_ns.load(std::memory_order_relaxed);
+		const uint64_t base_ticks = c.base_ticks.load(std::memory_order_relaxed);
+		const uint64_t ticks = detail::read_ticks();
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ((seq & 1) == 0 && c.seq.load(std::memory_order_relaxed) == seq) {
+			const __int128 d = (__int128)(int64_t)(ticks - base_ticks) * mult;
+			return {base_ns + (int64_t)(d >> 32)};
+		}
+	}
+#else
+	return now();
+#endif
+}
+
+// Timestamp cached by background clock thread, resolution is the refresh
+// period of that thread (see start_background_clock()). Costs a single relaxed
+// load. First call starts that thread with default 1 ms period.
+inline point now_coarse()
+{
+	const int64_t ns = detail::coarse_clock_ns.load(std::memory_order_relaxed);
+	if (ns > 0) {
+		return {ns};
+	}
+	return detail::_internal_coarse_clock_slow_path();
+}
+
+// Starts (or reconfigures) background thread which refreshes now_coarse()
+// every coarse_period and recalibrates now_fast() every recalibration_period.
+// Started implicitly by first now_coarse() or now_fast() call with default
+// periods of 1 ms and 1 s.
+void start_background_clock(diff coarse_period, diff recalibration_period);
+void start_background_clock();
+// Stops background thread; now_coarse() falls back to now() afterwards, and
+// now_fast() is not corrected for drift anymore.
+void stop_background_clock();
+// Forces immediate recalibration of now_fast().
+void recalibrate_fast_clock();
+// Whether now_fast() reads hardware counter or falls back to now().
+bool has_fast_clock();
+
 inline constexpr diff abs(diff t) { return t.ns < 0 ? diff{-t.ns} : t; }
 inline constexpr diff clamp(diff t, diff min, diff max) { return t.ns < min.ns ? min : t.ns > max.ns ? max : t; }
 inline constexpr diff min(diff a, diff b) { return a.ns < b.ns ? a : b; }
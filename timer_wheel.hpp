@@ -0,0 +1,368 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_TIMER_WHEEL_HPP
+#define CONCURRENT_TIMER_WHEEL_HPP
+
+#include <cstdint>
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+#include "mpsc_stack.hpp"
+#include "object_pool.hpp"
+#include "future.hpp"
+#include "time.hpp"
+
+namespace concurrent
+{
+//	Hierarchical timing wheel: LEVELS wheels of SLOTS slots, level k slot
+//	spans SLOTS^k ticks. Timers can be scheduled and cancelled from any
+//	thread in O(1): schedule() pushes node to lock-free mpsc::stack, which
+//	the single owner thread drains in advance(), cancel() only flips state of
+//	node and owner drops it lazily when it reaches its slot. advance() fires
+//	all timers due up to given time in one batch, cascading timers down from
+//	higher levels on slot boundaries. Timer nodes are allocated from
+//	object_pool.
+class timer_wheel
+{
+public:
+	static constexpr int SLOT_BITS = 6;
+	static constexpr int SLOTS = 1 << SLOT_BITS;
+	static constexpr int LEVELS = 6;
+
+private:
+	class timer_node : public node<timer_node>
+	{
+	public:
+		virtual void fire() = 0;
+		virtual void destroy() = 0;
+
+		inline void release_ref() {
+			if (refs.load(std::memory_order_acquire) == 1 ||
+					refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				destroy();
+			}
+		}
+
+		inline bool try_take(uint32_t to) {
+			uint32_t expected = PENDING;
+			return state.compare_exchange_strong(expected, to,
+					std::memory_order_acq_rel, std::memory_order_relaxed);
+		}
+
+		static constexpr uint32_t PENDING = 0;
+		static constexpr uint32_t CANCELLED = 1;
+		static constexpr uint32_t FIRED = 2;
+
+		int64_t tick = 0;
+		std::atomic<uint32_t> state = PENDING;
+		std::atomic<uint32_t> refs = 1;
+
+		virtual ~timer_node() = default;
+	};
+
+	template<typename F>
+	class timer_entry final : public timer_node
+	{
+	public:
+		using pool = object_pool<timer_entry<F>>;
+
+		template<typename F2>
+		timer_entry(F2 &&func) : func(std::forward<F2>(func)) {}
+
+		void fire() override {
+			func();
+		}
+
+		void destroy() override {
+			pool::release(this);
+		}
+
+	private:
+		F func;
+	};
+
+public:
+	//	Handle to scheduled timer, holds reference to its node so it can be
+	//	used after timer fired or wheel was destroyed. Destroying handle does
+	//	not cancel timer.
+	class timer final
+	{
+	public:
+		timer() = default;
+		~timer() {
+			if (n != NULL) {
+				n->release_ref();
+			}
+		}
+		timer(timer &&o) : n(o.n) {
+			o.n = NULL;
+		}
+		timer(const timer &) = delete;
+		timer &operator=(timer &&o) {
+			std::swap(n, o.n);
+			return *this;
+		}
+		timer &operator=(const timer &) = delete;
+
+		//	Safe from any thread, returns true when timer will not fire.
+		bool cancel() {
+			return n != NULL && n->try_take(timer_node::CANCELLED);
+		}
+
+		bool is_pending() const {
+			return n != NULL &&
+				n->state.load(std::memory_order_acquire) == timer_node::PENDING;
+		}
+
+		bool fired() const {
+			return n != NULL &&
+				n->state.load(std::memory_order_acquire) == timer_node::FIRED;
+		}
+
+		bool is_valid() const {
+			return n != NULL;
+		}
+
+		friend class timer_wheel;
+
+	private:
+		timer(timer_node *n) : n(n) {}
+
+		timer_node *n = NULL;
+	};
+
+public:
+	timer_wheel(time::diff resolution = time::milliseconds(1),
+			time::point start = time::now())
+		: origin(start), resolution(resolution.ns > 0 ? resolution : time::diff{1}) {
+	}
+
+	//	Pending timers are destroyed without firing.
+	~timer_wheel() {
+		_internal_destroy_list(incoming.pop_all());
+		for (int k = 0; k < LEVELS; ++k) {
+			for (int i = 0; i < SLOTS; ++i) {
+				_internal_destroy_list(slots[k][i]);
+			}
+		}
+	}
+
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel(timer_wheel &&) = delete;
+	timer_wheel &operator=(const timer_wheel &) = delete;
+	timer_wheel &operator=(timer_wheel &&) = delete;
+
+	//	Safe to call from any thread. func is run by thread calling advance()
+	//	at first advance() with time not before deadline, rounded up to
+	//	resolution.
+	template<typename F>
+	timer schedule(time::point deadline, F &&func) {
+		timer_node *n =
+			timer_entry<std::decay_t<F>>::pool::acquire_raw(std::forward<F>(func));
+		n->tick = _internal_tick_ceil(deadline);
+		n->refs.store(2, std::memory_order_relaxed);
+		incoming.push(n);
+		return timer(n);
+	}
+
+	template<typename F>
+	timer schedule_after(time::diff delay, F &&func) {
+		return schedule(time::now() + delay, std::forward<F>(func));
+	}
+
+	//	Fails promise of f with error if it is not finished by deadline.
+	//	Producer has to complete it with promise::try_set_value(), and
+	//	timer keeps state of f alive until it fires or is cancelled.
+	template<typename T>
+	timer fail_on_timeout(const future<T> &f, time::point deadline) {
+		return schedule(deadline, [f = f]() mutable {
+					f.try_fail();
+				});
+	}
+
+	//	Following functions may be called only by single owner thread.
+
+	//	Fires all timers due at or before now, returns number of fired
+	//	timers.
+	size_t advance(time::point now) {
+		size_t fired = _internal_drain_incoming();
+		const int64_t target = (now - origin).ns / resolution.ns;
+		while (current < target) {
+			if (count == 0) {
+				current = target;
+				break;
+			}
+			const int64_t next = _internal_next_interesting_tick();
+			if (next > target) {
+				current = target;
+				break;
+			}
+			current = next;
+			if ((current & (SLOTS - 1)) == 0) {
+				_internal_cascade();
+			}
+			fired += _internal_expire_slot(current & (SLOTS - 1));
+		}
+		return fired;
+	}
+
+	size_t advance() {
+		return advance(time::now());
+	}
+
+	//	Timers placed in wheel, including cancelled ones not dropped yet, not
+	//	counting ones still waiting in incoming stack.
+	size_t count_pending() const {
+		return count;
+	}
+
+	time::diff get_resolution() const {
+		return resolution;
+	}
+
+	//	Time up to which timers were fired.
+	time::point current_time() const {
+		return origin + resolution * current;
+	}
+
+private:
+	inline int64_t _internal_tick_ceil(time::point t) const {
+		const int64_t ns = (t - origin).ns;
+		if (ns <= 0) {
+			return 0;
+		}
+		return (ns + resolution.ns - 1) / resolution.ns;
+	}
+
+	//	Owner side insertion, requires n->tick >= current.
+	void _internal_insert(timer_node *n) {
+		int k = 0;
+		for (; k < LEVELS - 1; ++k) {
+			const int s = SLOT_BITS * k;
+			if ((n->tick >> s) - (current >> s) < SLOTS) {
+				break;
+			}
+		}
+		const int s = SLOT_BITS * k;
+		int64_t slot = n->tick >> s;
+		if (slot - (current >> s) >= SLOTS) {
+			// Beyond range of whole wheel, parked in last slot of top level
+			// and reinserted on its cascade.
+			slot = (current >> s) - 1;
+		}
+		const int i = slot & (SLOTS - 1);
+		n->__m_next.store(slots[k][i], std::memory_order_relaxed);
+		slots[k][i] = n;
+		occupied[k] |= (uint64_t)1 << i;
+		++count;
+	}
+
+	//	Moves scheduled timers to slots, fires ones already overdue.
+	size_t _internal_drain_incoming() {
+		timer_node *n = incoming.pop_all();
+		size_t fired = 0;
+		while (n != NULL) {
+			timer_node *next = n->__m_next.load(std::memory_order_relaxed);
+			if (n->state.load(std::memory_order_relaxed) != timer_node::PENDING) {
+				n->release_ref();
+			} else if (n->tick <= current) {
+				fired += _internal_fire(n);
+			} else {
+				_internal_insert(n);
+			}
+			n = next;
+		}
+		return fired;
+	}
+
+	//	Nearest tick after current which either has non-empty level 0 slot or
+	//	is slot boundary requiring cascade.
+	int64_t _internal_next_interesting_tick() const {
+		const int64_t boundary = (current | (SLOTS - 1)) + 1;
+		const int pos = (current + 1) & (SLOTS - 1);
+		// Bits for ticks current+1 .. boundary-1, which all lie in this round
+		// of level 0.
+		const uint64_t mask = pos == 0 ? 0 : (~(uint64_t)0 << pos);
+		const uint64_t bits = occupied[0] & mask;
+		if (bits != 0) {
+			return (current & ~(int64_t)(SLOTS - 1)) + __builtin_ctzll(bits);
+		}
+		return boundary;
+	}
+
+	void _internal_cascade() {
+		for (int k = 1; k < LEVELS; ++k) {
+			const int i = (current >> (SLOT_BITS * k)) & (SLOTS - 1);
+			timer_node *n = slots[k][i];
+			slots[k][i] = NULL;
+			occupied[k] &= ~((uint64_t)1 << i);
+			while (n != NULL) {
+				timer_node *next = n->__m_next.load(std::memory_order_relaxed);
+				--count;
+				if (n->state.load(std::memory_order_relaxed) != timer_node::PENDING) {
+					n->release_ref();
+				} else {
+					_internal_insert(n);
+				}
+				n = next;
+			}
+			if (i != 0) {
+				break;
+			}
+		}
+	}
+
+	size_t _internal_expire_slot(int i) {
+		timer_node *n = slots[0][i];
+		if (n == NULL) {
+			return 0;
+		}
+		slots[0][i] = NULL;
+		occupied[0] &= ~((uint64_t)1 << i);
+		size_t fired = 0;
+		while (n != NULL) {
+			timer_node *next = n->__m_next.load(std::memory_order_relaxed);
+			--count;
+			fired += _internal_fire(n);
+			n = next;
+		}
+		return fired;
+	}
+
+	inline size_t _internal_fire(timer_node *n) {
+		size_t fired = 0;
+		if (n->try_take(timer_node::FIRED)) {
+			n->fire();
+			fired = 1;
+		}
+		n->release_ref();
+		return fired;
+	}
+
+	void _internal_destroy_list(timer_node *n) {
+		while (n != NULL) {
+			timer_node *next = n->__m_next.load(std::memory_order_relaxed);
+			n->release_ref();
+			n = next;
+		}
+	}
+
+private:
+	mpsc::stack<timer_node> incoming;
+
+	const time::point origin;
+	const time::diff resolution;
+	int64_t current = 0;
+	size_t count = 0;
+
+	uint64_t occupied[LEVELS] = {};
+	timer_node *slots[LEVELS][SLOTS] = {};
+};
+}
+
+#endif
@@ -0,0 +1,303 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_TRACE_CPP
+#define CONCURRENT_TRACE_CPP
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "trace.hpp"
+
+namespace concurrent
+{
+namespace trace
+{
+namespace
+{
+struct registry {
+	std::mutex mutex;
+	std::vector<detail::thread_buffer *> buffers;
+	//	Dropped events of already freed buffers.
+	uint64_t dropped_of_freed = 0;
+	std::atomic<uint32_t> next_tid = 1;
+};
+
+registry &get_registry()
+{
+	// Leaked, threads may exit after static destructors ran.
+	static registry *r = new registry();
+	return *r;
+}
+
+struct buffer_owner {
+	detail::thread_buffer *buffer = NULL;
+
+	~buffer_owner()
+	{
+		if (buffer != NULL) {
+			detail::local_buffer = NULL;
+			buffer->retired.store(true, std::memory_order_release);
+		}
+	}
+};
+
+thread_local buffer_owner owner;
+
+void write_escaped(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; s != NULL && *s; ++s) {
+		const unsigned char c = *s;
+		if (c == '"' || c == '\\') {
+			fputc('\\', f);
+			fputc(c, f);
+		} else if (c < 0x20) {
+			fprintf(f, "\\u%04x", c);
+		} else {
+			fputc(c, f);
+		}
+	}
+	fputc('"', f);
+}
+} // namespace
+
+namespace detail
+{
+thread_buffer *_internal_register_thread()
+{
+	registry &r = get_registry();
+	thread_buffer *b = new thread_buffer();
+	b->tid = r.next_tid.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard lock(r.mutex);
+		r.buffers.push_back(b);
+	}
+	owner.buffer = b;
+	local_buffer = b;
+	return b;
+}
+} // namespace detail
+
+void set_thread_name(const char *name)
+{
+	detail::thread_buffer *b = detail::local_buffer;
+	if (b == NULL) {
+		b = detail::_internal_register_thread();
+	}
+	b->thread_name.store(name, std::memory_order_release);
+}
+
+struct collector::impl {
+	FILE *file = NULL;
+	bool owns_file = false;
+	bool first_event = true;
+	int pid = 1;
+	time::diff period;
+	time::point origin;
+	uint64_t written = 0;
+
+	std::mutex drain_mutex;
+	//	Thread names already written, indexed by tid.
+	std::vector<const char *> written_names;
+
+	std::mutex sleep_mutex;
+	std::condition_variable cv;
+	bool stop = false;
+	std::thread thread;
+
+	void begin()
+	{
+#if defined(__linux__)
+		pid = getpid();
+#endif
+		if (file != NULL) {
+			fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		}
+		drain(false);
+		origin = time::now_fast();
+		detail::enabled.store(true, std::memory_order_release);
+		thread = std::thread([this]() { run(); });
+	}
+
+	void finish()
+	{
+		detail::enabled.store(false, std::memory_order_release);
+		{
+			std::lock_guard lock(sleep_mutex);
+			stop = true;
+		}
+		cv.notify_all();
+		if (thread.joinable()) {
+			thread.join();
+		}
+		drain(true);
+		if (file != NULL) {
+			fprintf(file, "\n]}\n");
+			fflush(file);
+			if (owns_file) {
+				fclose(file);
+			}
+		}
+	}
+
+	void run()
+	{
+		std::unique_lock lock(sleep_mutex);
+		while (stop == false) {
+			cv.wait_for(lock, std::chrono::nanoseconds(period.ns));
+			lock.unlock();
+			drain(true);
+			lock.lock();
+		}
+	}
+
+	void write_prefix()
+	{
+		if (first_event == false) {
+			fputs(",\n", file);
+		}
+		first_event = false;
+	}
+
+	void write_thread_name(detail::thread_buffer *b)
+	{
+		const char *name = b->thread_name.load(std::memory_order_acquire);
+		if (name == NULL) {
+			return;
+		}
+		if (written_names.size() <= b->tid) {
+			written_names.resize(b->tid + 1, NULL);
+		}
+		if (written_names[b->tid] == name) {
+			return;
+		}
+		written_names[b->tid] = name;
+		write_prefix();
+		fprintf(file,
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+				"\"args\":{\"name\":",
+				pid, b->tid);
+		write_escaped(file, name);
+		fputs("}}", file);
+	}
+
+	void write_event(const detail::thread_buffer *b, const event &e)
+	{
+		write_prefix();
+		//	Microseconds, sign is written separately so that -500 ns is not
+		//	printed as 0.500.
+		const int64_t ts = e.ts - origin.ns;
+		const uint64_t abs_ts = ts < 0 ? -(uint64_t)ts : (uint64_t)ts;
+		fprintf(file,
+				"{\"ph\":\"%c\",\"ts\":%s%llu.%03llu,\"pid\":%d,\"tid\":%u",
+				e.phase, ts < 0 ? "-" : "", (unsigned long long)(abs_ts / 1000),
+				(unsigned long long)(abs_ts % 1000), pid, b->tid);
+		if (e.name != NULL) {
+			fputs(",\"name\":", file);
+			write_escaped(file, e.name);
+		}
+		if (e.phase == 'i') {
+			fputs(",\"s\":\"t\"", file);
+		} else if (e.phase == 'C') {
+			fprintf(file, ",\"args\":{\"value\":%lld}", (long long)e.value);
+		}
+		fputc('}', file);
+		++written;
+	}
+
+	//	With output false events are discarded.
+	void drain(bool output)
+	{
+		registry &r = get_registry();
+		std::lock_guard drain_lock(drain_mutex);
+		std::lock_guard lock(r.mutex);
+		output = output && file != NULL;
+		for (size_t i = 0; i < r.buffers.size();) {
+			detail::thread_buffer *b = r.buffers[i];
+			// Read before draining, so events pushed before retirement are
+			// not lost.
+			const bool retired = b->retired.load(std::memory_order_acquire);
+			if (output) {
+				write_thread_name(b);
+			}
+			event e;
+			while (b->ring.pop(e)) {
+				if (output) {
+					write_event(b, e);
+				}
+			}
+			if (retired) {
+				r.dropped_of_freed += b->dropped.load(std::memory_order_relaxed);
+				delete b;
+				r.buffers[i] = r.buffers.back();
+				r.buffers.pop_back();
+			} else {
+				++i;
+			}
+		}
+		if (output) {
+			fflush(file);
+		}
+	}
+};
+
+collector::collector(const char *path, time::diff period) : p(new impl())
+{
+	p->file = fopen(path, "w");
+	p->owns_file = true;
+	p->period = period;
+	p->begin();
+}
+
+collector::collector(FILE *file, time::diff period) : p(new impl())
+{
+	p->file = file;
+	p->period = period;
+	p->begin();
+}
+
+collector::~collector()
+{
+	p->finish();
+	delete p;
+}
+
+bool collector::is_open() const
+{
+	return p->file != NULL;
+}
+
+void collector::flush()
+{
+	p->drain(true);
+}
+
+uint64_t collector::count_written_events() const
+{
+	std::lock_guard lock(p->drain_mutex);
+	return p->written;
+}
+
+uint64_t collector::count_dropped_events() const
+{
+	registry &r = get_registry();
+	std::lock_guard lock(r.mutex);
+	uint64_t sum = r.dropped_of_freed;
+	for (detail::thread_buffer *b : r.buffers) {
+		sum += b->dropped.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+} // namespace trace
+} // namespace concurrent
+
+#endif
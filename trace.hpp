@@ -0,0 +1,144 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_TRACE_HPP
+#define CONCURRENT_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+
+#include <atomic>
+
+#include "spsc_ringbuffer.hpp"
+#include "time.hpp"
+
+#ifndef CONCURRENT_TRACE_BUFFER_EVENTS
+#define CONCURRENT_TRACE_BUFFER_EVENTS 8192
+#endif
+
+namespace concurrent
+{
+//	Per-thread trace event recorder. Events are written into thread owned
+//	spsc::ringbuffer and drained by trace::collector thread into Chrome trace
+//	event JSON (loadable by chrome://tracing and ui.perfetto.dev). Events are
+//	recorded only while collector exists, otherwise each call costs a single
+//	relaxed load. When buffer of a thread is full its events are dropped and
+//	counted. Names have to be string literals or otherwise outlive collector.
+//	Requires linking trace.cpp.
+namespace trace
+{
+struct event {
+	const char *name;
+	int64_t ts;
+	int64_t value;
+	char phase;
+};
+
+namespace detail
+{
+struct thread_buffer {
+	spsc::ringbuffer<event, CONCURRENT_TRACE_BUFFER_EVENTS> ring;
+	//	Written only by owning thread.
+	std::atomic<uint64_t> dropped = 0;
+	//	Set when owning thread exits, collector frees drained buffer.
+	std::atomic<bool> retired = false;
+	std::atomic<const char *> thread_name = NULL;
+	uint32_t tid = 0;
+};
+
+inline std::atomic<bool> enabled = false;
+inline thread_local thread_buffer *local_buffer = NULL;
+
+thread_buffer *_internal_register_thread();
+
+inline void _internal_emit(char phase, const char *name, int64_t value) {
+	if (enabled.load(std::memory_order_relaxed) == false) {
+		return;
+	}
+	thread_buffer *b = local_buffer;
+	if (b == NULL) {
+		b = _internal_register_thread();
+	}
+	if (b->ring.is_full()) {
+		b->dropped.store(b->dropped.load(std::memory_order_relaxed) + 1,
+				std::memory_order_relaxed);
+		return;
+	}
+	b->ring.head() = {name, time::now_fast().ns, value, phase};
+	b->ring.push();
+}
+} // namespace detail
+
+inline void begin(const char *name) {
+	detail::_internal_emit('B', name, 0);
+}
+
+//	Closes most recent begin() of this thread.
+inline void end(const char *name = NULL) {
+	detail::_internal_emit('E', name, 0);
+}
+
+inline void instant(const char *name) {
+	detail::_internal_emit('i', name, 0);
+}
+
+//	Counter track value, shown as graph.
+inline void counter(const char *name, int64_t value) {
+	detail::_internal_emit('C', name, value);
+}
+
+//	Name shown for calling thread, name has to outlive collector.
+void set_thread_name(const char *name);
+
+//	begin() in constructor, end() in destructor.
+class scope
+{
+public:
+	scope(const char *name) : name(name) {
+		begin(name);
+	}
+	~scope() {
+		end(name);
+	}
+
+	scope(const scope &) = delete;
+	scope &operator=(const scope &) = delete;
+
+private:
+	const char *name;
+};
+
+//	Enables recording and drains buffers of all threads every period into
+//	JSON file, destructor drains remaining events, closes JSON and disables
+//	recording. Only one collector may exist at a time.
+class collector
+{
+public:
+	collector(const char *path, time::diff period = time::milliseconds(10));
+	//	Writes into already opened file, which is not closed.
+	collector(FILE *file, time::diff period = time::milliseconds(10));
+	~collector();
+
+	collector(const collector &) = delete;
+	collector(collector &&) = delete;
+	collector &operator=(const collector &) = delete;
+	collector &operator=(collector &&) = delete;
+
+	bool is_open() const;
+	//	Drains buffers immediately from calling thread.
+	void flush();
+
+	uint64_t count_written_events() const;
+	//	Events lost because buffer of their thread was full.
+	uint64_t count_dropped_events() const;
+
+private:
+	struct impl;
+	impl *p;
+};
+} // namespace trace
+}
+
+#endif
@@ -0,0 +1,63 @@
+// Copyright (C) 2025 Marek Zalewski aka Drwalin
+//
+// This file is part of Concurrent project under MIT License
+// You should have received a copy of the MIT License along with this program.
+
+#ifndef CONCURRENT_WORK_ITEM_HPP
+#define CONCURRENT_WORK_ITEM_HPP
+
+#include <utility>
+#include <type_traits>
+
+#include "node.hpp"
+#include "object_pool.hpp"
+
+namespace concurrent
+{
+//	Type erased function queued in executors, linkable into node based
+//	stacks and queues.
+class work_item : public node<work_item>
+{
+public:
+	//	Runs and releases item.
+	virtual void run() = 0;
+	//	Releases item without running it.
+	virtual void discard() = 0;
+	
+	virtual ~work_item() = default;
+	
+	//	Allocates item from object_pool.
+	template<typename F>
+	static work_item *create(F &&func);
+};
+
+template<typename F>
+class work final : public work_item
+{
+public:
+	using pool = object_pool<work<F>>;
+	
+	template<typename F2>
+	work(F2 &&func) : func(std::forward<F2>(func)) {}
+	
+	void run() override {
+		F f = std::move(func);
+		pool::release(this);
+		f();
+	}
+	
+	void discard() override {
+		pool::release(this);
+	}
+	
+private:
+	F func;
+};
+
+template<typename F>
+inline work_item *work_item::create(F &&func) {
+	return work<std::decay_t<F>>::pool::acquire_raw(std::forward<F>(func));
+}
+}
+
+#endif